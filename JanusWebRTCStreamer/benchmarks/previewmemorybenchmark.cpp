@@ -0,0 +1,118 @@
+#include <QtTest>
+#include <QApplication>
+#include <QWebChannel>
+#include <QWebEnginePage>
+#include <QWebEngineSettings>
+#include <QWebEngineView>
+#include <memory>
+#include <vector>
+#include "janusconnector.h"
+#include "metrics.h"
+#include "webviewpool.h"
+
+// Idle resident memory per registered camera in the GUI app, before and
+// after previews moved to the bounded WebViewPool. Needs WebEngine, so it
+// is a separate binary from camstream_bench and only built with the GUI.
+//
+// The "legacy" row gives every connector its own QWebEngineView and
+// QWebChannel, as JanusConnector's constructor used to. The "pooled" row
+// is the current layout: connectors share one pool that creates no view
+// until a preview is shown.
+
+namespace {
+
+const int Cameras = 200;
+
+// What JanusConnector's constructor built for every camera
+struct LegacyPreview {
+    std::unique_ptr<QWebEngineView> view;
+    QWebChannel *channel;
+};
+
+LegacyPreview createLegacyPreview(QObject *connector)
+{
+    LegacyPreview preview;
+    preview.view.reset(new QWebEngineView());
+    preview.view->resize(1280, 720);
+    preview.view->setWindowTitle("Janus WebRTC Stream");
+
+    QWebEngineSettings *settings = preview.view->page()->settings();
+    settings->setAttribute(QWebEngineSettings::JavascriptEnabled, true);
+    settings->setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls, true);
+    settings->setAttribute(QWebEngineSettings::AllowRunningInsecureContent, true);
+
+    preview.channel = new QWebChannel(preview.view.get());
+    preview.view->page()->setWebChannel(preview.channel);
+    preview.channel->registerObject("qtConnector", connector);
+    return preview;
+}
+
+} // namespace
+
+class PreviewMemoryBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void idleMemoryPerCamera_data();
+    void idleMemoryPerCamera();
+};
+
+void PreviewMemoryBenchmark::initTestCase()
+{
+    if (Metrics::residentBytes() < 0) QSKIP("Resident memory is not available on this platform");
+
+    // WebEngine's profile and process setup is paid once, not per camera
+    QObject connector;
+    createLegacyPreview(&connector);
+}
+
+void PreviewMemoryBenchmark::idleMemoryPerCamera_data()
+{
+    QTest::addColumn<bool>("legacy");
+
+    // Pooled first: freed legacy views would otherwise be reused by it
+    QTest::newRow("pooled") << false;
+    QTest::newRow("legacy") << true;
+}
+
+void PreviewMemoryBenchmark::idleMemoryPerCamera()
+{
+    // Resident growth for cameras that are registered but not previewed.
+    // Reported in the BytesAllocated metric.
+    QFETCH(bool, legacy);
+
+    WebViewPool pool;
+    std::vector<std::unique_ptr<JanusConnector>> connectors;
+    std::vector<LegacyPreview> previews;
+    connectors.reserve(Cameras);
+    previews.reserve(Cameras);
+
+    const qint64 before = Metrics::residentBytes();
+    for (int i = 0; i < Cameras; i++) {
+        connectors.emplace_back(new JanusConnector);
+        if (legacy) {
+            previews.push_back(createLegacyPreview(connectors.back().get()));
+        } else {
+            connectors.back()->setPreviewProvider(&pool);
+        }
+    }
+    QCoreApplication::processEvents();
+    const qint64 after = Metrics::residentBytes();
+
+    QTest::setBenchmarkResult(qreal(after - before) / Cameras, QTest::BytesAllocated);
+}
+
+int main(int argc, char *argv[])
+{
+    // The views are never shown, so no display is needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    PreviewMemoryBenchmark benchmark;
+    return QTest::qExec(&benchmark, argc, argv);
+}
+
+#include "previewmemorybenchmark.moc"
@@ -1,10 +1,32 @@
 #include "cameramanager.h"
 #include "janusconnector.h"
+#include "metrics.h"
+#include "logger.h"
+#include <QStandardPaths>
+
+namespace {
+
+// Pages send a heartbeat every 20 seconds while they show the stream
+const qint64 ViewerTimeoutMs = 60000;
+
+// Viewer IDs come from the pages; this bounds what one camera can hold
+const int MaxViewersPerCamera = 256;
+
+} // namespace
 
 CameraManager::CameraManager(QObject *parent)
     : QObject(parent)
     , m_httpServer(new HttpServer(this))
     , m_janusUrl("http://10.10.205.65:8088/janus")
+    , m_keepAliveScheduler(new KeepAliveScheduler(30000, 30, this))
+    , m_onDemand(false)
+    , m_idleTtlMs(300000)
+    , m_idleSweepTimer(new QTimer(this))
+    , m_registryLog(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/cameras.jsonl")
+    , m_maxConcurrentSetups(16)
+    , m_pumpingSetups(false)
+    , m_pumpAgain(false)
+    , m_retryScheduler(new RetryScheduler(RetryScheduler::Policy(), this))
     //, m_janusConnector(new JanusConnector(this))
 {
     // Connect HTTP server signals
@@ -12,6 +34,23 @@ CameraManager::CameraManager(QObject *parent)
             this, &CameraManager::onCameraParametersReceived);
     connect(m_httpServer, &HttpServer::serverError,
             this, &CameraManager::onHttpServerError);
+    connect(this, &CameraManager::cameraSetupFinished,
+            m_httpServer, &HttpServer::reportCameraSetupResult);
+    connect(m_httpServer, &HttpServer::streamRequested,
+            this, &CameraManager::onStreamRequested);
+    connect(m_httpServer, &HttpServer::viewerActivity,
+            this, &CameraManager::onViewerActivity);
+    // Workers refuse provisioning requests the setup queue has no room for
+    m_httpServer->setSetupQueue(&m_setupQueue);
+
+    connect(m_retryScheduler, &RetryScheduler::retryDue,
+            this, &CameraManager::onRetryDue);
+    connect(m_retryScheduler, &RetryScheduler::nodeAvailable,
+            this, &CameraManager::pumpSetupQueue);
+
+    m_demandClock.start();
+    m_idleSweepTimer->setInterval(10000); // 10 seconds
+    connect(m_idleSweepTimer, &QTimer::timeout, this, &CameraManager::sweepIdleMountpoints);
 
     // Connect Janus connector signals
     // connect(m_janusConnector, &JanusConnector::streamingStarted,
@@ -33,6 +72,10 @@ bool CameraManager::startService(quint16 httpPort)
         return false;
     }
 
+    // Learn which mountpoints survived on Janus before cameras re-register
+    sessionPoolFor(m_janusUrl)->mountpoints()->reconcile();
+    restoreCameras();
+    if (m_onDemand) m_idleSweepTimer->start();
 
     qDebug() << "Camera streaming service started on port:" << httpPort;
     qDebug() << "Send POST requests to: http://localhost:" << httpPort << "/camera/{uuid}";
@@ -46,20 +89,130 @@ void CameraManager::setStreamCredentials(const QString &username, const QString
     m_httpServer->setCredentials(username, password);
 }
 
+void CameraManager::setPreviewProvider(PreviewProvider *provider)
+{
+    m_previewProvider = provider;
+}
+
+void CameraManager::setMaxConcurrentSetups(int maxSetups)
+{
+    m_maxConcurrentSetups = qMax(1, maxSetups);
+    pumpSetupQueue();
+}
+
+void CameraManager::setSetupQueueLimits(int maxQueued, int maxQueuedPerCustomer)
+{
+    m_setupQueue.setLimits(maxQueued, maxQueuedPerCustomer);
+}
+
 void CameraManager::stopService()
 {
     m_httpServer->stopServer();
 
+    const QList<SetupQueue::Entry> pending = m_setupQueue.takeAll();
+    for (const SetupQueue::Entry &entry : pending) {
+        emit cameraSetupFinished(entry.params.cameraUUID, false, "Service stopped", actionName(entry.action));
+    }
+    m_setupsInFlight.clear();
+    m_retries.clear();
+    Metrics::global().setupsInFlight.set(0);
+
     for (auto it = m_janusConnectors.begin(); it != m_janusConnectors.end(); ++it) {
         it.value()->disconnect();
         it.value()->deleteLater();
     }
     m_janusConnectors.clear();
+    m_connectorCameras.clear();
+    m_viewerDemand.clear();
+    m_restoredPages.clear();
+    m_restoring.clear();
+    m_idleSweepTimer->stop();
 
     emit serviceStopped();
     qDebug() << "Camera streaming service stopped";
 }
 
+void CameraManager::setRegistryPath(const QString &path)
+{
+    m_registryLog.setPath(path);
+}
+
+void CameraManager::setOnDemandMountpoints(bool enabled, int idleTtlSeconds)
+{
+    m_onDemand = enabled;
+    m_idleTtlMs = qMax(1, idleTtlSeconds) * 1000;
+}
+
+void CameraManager::restoreCameras()
+{
+    MountpointCatalog *catalog = sessionPoolFor(m_janusUrl)->mountpoints();
+    const QList<CameraRecord> records = m_registryLog.load();
+
+    for (const CameraRecord &record : records) {
+        m_restoring.insert(record.params.cameraUUID);
+
+        // Serve the last known page right away; setup below adopts the
+        // mountpoint once reconciliation is done and refreshes the page.
+        // Its ID is held for this camera so no other camera is given it.
+        // Mountpoints on another Janus node are simply set up again here.
+        if (record.mountpointId > 0 && record.janusUrl == m_janusUrl) {
+            catalog->reserve(record.mountpointId, record.params);
+            m_restoredPages.insert(record.params.cameraUUID, record);
+            m_httpServer->registerStream(record.params.cameraUUID, record.params,
+                                         record.mountpointId, record.janusUrl);
+        }
+        onCameraParametersReceived(record.params);
+    }
+
+    if (!m_restoredPages.isEmpty()) {
+        if (catalog->isReady()) {
+            dropStaleRestoredPages();
+        } else {
+            connect(catalog, &MountpointCatalog::ready,
+                    this, &CameraManager::dropStaleRestoredPages, Qt::SingleShotConnection);
+        }
+    }
+
+    if (m_restoring.isEmpty()) finishRestore();
+
+    if (!records.isEmpty()) {
+        qDebug() << "Restored" << records.size() << "cameras from" << m_registryLog.path();
+    }
+}
+
+void CameraManager::dropStaleRestoredPages()
+{
+    // Janus lost the mountpoint and something else now has its ID: the
+    // early page would show another camera until setup replaces it
+    MountpointCatalog *catalog = sessionPoolFor(m_janusUrl)->mountpoints();
+    for (const CameraRecord &record : std::as_const(m_restoredPages)) {
+        if (!catalog->serves(record.mountpointId, record.params)) {
+            LOG_INFO("restored_page_dropped").field("camera", record.params.cameraUUID)
+                .field("mountpoint", record.mountpointId);
+            m_httpServer->unregisterStream(record.params.cameraUUID);
+        }
+    }
+    m_restoredPages.clear();
+}
+
+void CameraManager::noteRestoreProgress(const QString &cameraUUID)
+{
+    if (m_restoring.remove(cameraUUID) && m_restoring.isEmpty()) finishRestore();
+}
+
+void CameraManager::finishRestore()
+{
+    // Every restored camera has adopted its mountpoint or made a new one;
+    // what is left on Janus belongs to no camera but still pulls its source
+    MountpointCatalog *catalog = sessionPoolFor(m_janusUrl)->mountpoints();
+    if (catalog->isReady()) {
+        catalog->destroyUnclaimed();
+    } else {
+        connect(catalog, &MountpointCatalog::ready,
+                catalog, &MountpointCatalog::destroyUnclaimed, Qt::SingleShotConnection);
+    }
+}
+
 void CameraManager::setJanusUrl(const QString &url)
 {
     m_janusUrl = url;
@@ -68,22 +221,80 @@ void CameraManager::setJanusUrl(const QString &url)
 
 void CameraManager::onCameraParametersReceived(const CameraParams &params)
 {
-    qDebug() << "Received camera parameters for UUID:" << params.cameraUUID;
+    LOG_DEBUG("camera_received").field("camera", params.cameraUUID).field("customer", params.customerName);
+
+    JanusConnector *existing = m_janusConnectors.value(params.cameraUUID);
+    if (!existing) {
+        provisionCamera(params, ProvisionAction::Created);
+        return;
+    }
 
-    // Check if connector already exists**
-    if (m_janusConnectors.contains(params.cameraUUID)) {
+    // Same parameters already on their way through setup: that result
+    // answers this request too
+    CameraParams queued;
+    if (m_setupQueue.contains(params.cameraUUID, &queued) && queued == params) return;
+    auto inFlight = m_setupsInFlight.constFind(existing);
+    if (inFlight != m_setupsInFlight.cend() && inFlight->params == params) return;
+
+    // Reserved on-demand cameras count as up; they just have no mountpoint yet
+    const bool up = existing->isConnected() || existing->isReserved();
+    if (up && !m_setupsInFlight.contains(existing)) {
+        const CameraParams current = existing->currentParams();
+        if (current == params) {
+            // The upstream system re-posts its full camera list; leave
+            // viewers and the RTSP pull alone. Only while the mountpoint is
+            // known to exist, though: after a Janus restart the re-post is
+            // what brings the camera back.
+            const bool live = existing->isReserved()
+                              || sessionPoolFor(existing->janusUrl())->mountpoints()->isLive(existing->mountpointId());
+            if (live) {
+                emit cameraSetupFinished(params.cameraUUID, true, QString(), actionName(ProvisionAction::Unchanged));
+                return;
+            }
+            provisionCamera(params, ProvisionAction::Recreated);
+            return;
+        }
+
+        // Only the source decides which mountpoint serves a camera;
+        // names and credentials are edited in place
+        if (current.rtspUrl == params.rtspUrl && current.ip == params.ip) {
+            m_setupQueue.push(params, ProvisionAction::Updated, hasViewers(params.cameraUUID));
+            pumpSetupQueue();
+            return;
+        }
+    }
+
+    provisionCamera(params, ProvisionAction::Recreated);
+}
+
+void CameraManager::provisionCamera(const CameraParams &params, ProvisionAction action)
+{
+    if (JanusConnector *existing = m_janusConnectors.value(params.cameraUUID)) {
 
         //Unregister existing stream
         m_httpServer->unregisterStream(params.cameraUUID);
-        // Stop existing stream
-        m_janusConnectors[params.cameraUUID]->disconnect();
-        m_janusConnectors[params.cameraUUID]->deleteLater();
-        m_janusConnectors.remove(params.cameraUUID);
+        // Stop existing stream and free its mountpoint on Janus
+        existing->removeMountpoint();
+        existing->disconnect();
+        existing->deleteLater();
+        removeConnector(params.cameraUUID);
+
+        // The replacement reports for this camera, so drop the old setup quietly
+        m_setupsInFlight.remove(existing);
+        m_retryScheduler->cancel(params.cameraUUID);
+        m_retries.remove(params.cameraUUID);
+        m_setupQueue.remove(params.cameraUUID);
     }
 
     // Create new connector for this camera
     JanusConnector *connector = new JanusConnector(this);
     connector->setJanusUrl(m_janusUrl);
+    connector->setSessionPool(sessionPoolFor(m_janusUrl));
+    connector->setPreviewProvider(m_previewProvider);
+    connector->setOnDemand(m_onDemand);
+    if (m_restoredPages.contains(params.cameraUUID)) {
+        connector->setPreferredMountpointId(m_restoredPages.value(params.cameraUUID).mountpointId);
+    }
 
     // Connect signals with camera UUID tracking
     connect(connector, &JanusConnector::streamingStarted,
@@ -94,14 +305,21 @@ void CameraManager::onCameraParametersReceived(const CameraParams &params)
             this, &CameraManager::onJanusError);
     connect(connector, &JanusConnector::sessionReady,
             this, &CameraManager::onSessionReady);
+    connect(connector, &JanusConnector::mountpointReserved,
+            this, &CameraManager::onMountpointReserved);
+    connect(connector, &JanusConnector::mountpointUpdated,
+            this, &CameraManager::onMountpointUpdated);
+    connect(connector, &JanusConnector::updateFailed,
+            this, &CameraManager::onMountpointUpdateFailed);
     connect(connector, &QObject::destroyed,
             this, &CameraManager::onConnectorDestroyed);
 
-    // Store connector in map
-    m_janusConnectors[params.cameraUUID] = connector;
+    // Store connector in both directions of the index
+    addConnector(params.cameraUUID, connector);
 
-    // Start connection
-    connector->connectToJanus(params);
+    // Queue the Janus setup; it starts once a setup slot is free
+    m_setupQueue.push(params, action, hasViewers(params.cameraUUID));
+    pumpSetupQueue();
 
     // m_currentCameraUUID = params.cameraUUID;
 
@@ -114,78 +332,383 @@ void CameraManager::onCameraParametersReceived(const CameraParams &params)
     // m_janusConnector->connectToJanus(params);
 }
 
+void CameraManager::addConnector(const QString &cameraUUID, JanusConnector *connector)
+{
+    m_janusConnectors.insert(cameraUUID, connector);
+    m_connectorCameras.insert(connector, cameraUUID);
+}
+
+void CameraManager::removeConnector(const QString &cameraUUID)
+{
+    JanusConnector *connector = m_janusConnectors.take(cameraUUID);
+    if (connector) {
+        m_connectorCameras.remove(connector);
+        if (m_mountpointCameras.value(connector->mountpointId()) == cameraUUID) {
+            m_mountpointCameras.remove(connector->mountpointId());
+        }
+    }
+}
+
+JanusSessionPool *CameraManager::sessionPoolFor(const QString &janusUrl)
+{
+    JanusSessionPool *pool = m_sessionPools.value(janusUrl);
+    if (!pool) {
+        pool = new JanusSessionPool(janusUrl, m_keepAliveScheduler, 2, this);
+        connect(pool, &JanusSessionPool::pluginEvent,
+                this, &CameraManager::onJanusPluginEvent);
+        // Janus may have restarted and taken its mountpoints with it
+        connect(pool, &JanusSessionPool::sessionReestablished,
+                pool->mountpoints(), &MountpointCatalog::recheck);
+        connect(pool->mountpoints(), &MountpointCatalog::mountpointsLost,
+                this, &CameraManager::onMountpointsLost);
+        m_sessionPools.insert(janusUrl, pool);
+    }
+    return pool;
+}
+
+void CameraManager::pumpSetupQueue()
+{
+    // A setup can finish synchronously inside the loop and pump again;
+    // that only asks for another pass, so a long backlog can't recurse
+    if (m_pumpingSetups) {
+        m_pumpAgain = true;
+        return;
+    }
+    m_pumpingSetups = true;
+
+    do {
+        m_pumpAgain = false;
+        SetupQueue::Entry setup;
+        while (m_setupsInFlight.size() < m_maxConcurrentSetups && m_setupQueue.pop(&setup)) {
+            JanusConnector *connector = m_janusConnectors.value(setup.params.cameraUUID);
+            if (!connector) continue;
+
+            // Janus node's breaker is open: hold the queue until nodeAvailable
+            if (!m_retryScheduler->tryAcquire(connector->janusUrl())) {
+                m_setupQueue.pushFront(setup);
+                break;
+            }
+
+            m_setupsInFlight.insert(connector, { setup.action, setup.params });
+            if (setup.action == ProvisionAction::Updated) {
+                connector->updateMountpoint(setup.params);
+            } else {
+                connector->connectToJanus(setup.params);
+            }
+        }
+    } while (m_pumpAgain);
+
+    m_pumpingSetups = false;
+    Metrics::global().setupsInFlight.set(m_setupsInFlight.size());
+}
+
+void CameraManager::finishSetup(const QObject *connector, bool success, const QString &error)
+{
+    auto it = m_setupsInFlight.find(connector);
+    if (it == m_setupsInFlight.end()) return;
+    const ProvisionAction action = it->action;
+    m_setupsInFlight.erase(it);
+
+    const QString cameraUUID = m_connectorCameras.value(connector);
+    if (success) {
+        if (const JanusConnector *janusConnector = qobject_cast<const JanusConnector*>(connector)) {
+            m_retryScheduler->recordSuccess(janusConnector->janusUrl(), cameraUUID);
+        }
+    }
+
+    // Restored cameras live on m_janusUrl; once its catalog is ready the
+    // setup got as far as trying to adopt
+    if (sessionPoolFor(m_janusUrl)->mountpoints()->isReady()) noteRestoreProgress(cameraUUID);
+
+    emit cameraSetupFinished(cameraUUID, success, error, actionName(action));
+    pumpSetupQueue();
+}
+
 void CameraManager::onSessionReady(qint64 sessionId, qint64 handleId)
 {
+    Q_UNUSED(sessionId)
+    Q_UNUSED(handleId)
+
     JanusConnector *connector = qobject_cast<JanusConnector*>(sender());
     if (!connector) return;
 
-    // Find the camera UUID for this connector
-    for (auto it = m_janusConnectors.begin(); it != m_janusConnectors.end(); ++it) {
-        if (it.value() == connector) {
-            // **CHANGED: Get actual mountpoint ID from connector**
-            int mountpointId = connector->mountpointId();
-
-            // **CHANGED: Get actual camera parameters from connector**
-            CameraParams params = connector->currentParams();
-
-            m_httpServer->registerStream(it.key(), params, mountpointId, m_janusUrl);
-            qDebug() << "Stream ready for public access:" << it.key();
-            qDebug() << "Mountpoint ID:" << mountpointId;
-            qDebug("Public URL: http://localhost:8080/stream/%s", it.key().toUtf8().constData());
-            break;
-        }
+    // On demand, a live mountpoint is subject to the idle TTL from now on;
+    // this also covers mountpoints adopted at startup
+    const QString cameraUUID = m_connectorCameras.value(connector);
+    if (m_onDemand && !cameraUUID.isEmpty()) {
+        ViewerDemand &demand = m_viewerDemand[cameraUUID];
+        demand.lastActivity = qMax(demand.lastActivity, m_demandClock.elapsed());
     }
+
+    streamReady(connector);
 }
 
-void CameraManager::onStreamingStarted()
+void CameraManager::onMountpointReserved()
 {
-
-    // Find which connector sent the signal
     JanusConnector *connector = qobject_cast<JanusConnector*>(sender());
+    if (connector) streamReady(connector);
+}
+
+void CameraManager::streamReady(JanusConnector *connector)
+{
+    const QString cameraUUID = m_connectorCameras.value(connector);
+    if (cameraUUID.isEmpty()) return;
+
+    // **CHANGED: Get actual mountpoint ID from connector**
+    int mountpointId = connector->mountpointId();
+
+    // **CHANGED: Get actual camera parameters from connector**
+    CameraParams params = connector->currentParams();
+
+    m_mountpointCameras.insert(mountpointId, cameraUUID);
+    m_registryLog.append({ params, mountpointId, m_janusUrl });
+    m_httpServer->registerStream(cameraUUID, params, mountpointId, m_janusUrl);
+    LOG_INFO("stream_ready").field("camera", cameraUUID).field("mountpoint", mountpointId);
+
+    finishSetup(connector, true, QString());
+}
+
+void CameraManager::onStreamRequested(const QString &cameraUUID)
+{
+    // A viewer is waiting on this camera; set it up ahead of bulk work
+    m_setupQueue.promote(cameraUUID);
+    noteDemand(cameraUUID);
+}
+
+void CameraManager::onViewerActivity(const QString &cameraUUID, const QString &viewerId, bool leaving)
+{
+    // Beacons only keep a stream warm: starting a mountpoint or jumping the
+    // setup queue is left to the authenticated page request
+    if (!m_onDemand || !m_janusConnectors.contains(cameraUUID)) return;
+
+    if (leaving) {
+        auto it = m_viewerDemand.find(cameraUUID);
+        if (it != m_viewerDemand.end()) it->viewers.remove(viewerId);
+        return;
+    }
+
+    ViewerDemand &demand = m_viewerDemand[cameraUUID];
+    if (!demand.viewers.contains(viewerId) && demand.viewers.size() >= MaxViewersPerCamera) return;
+    demand.viewers.insert(viewerId, m_demandClock.elapsed());
+    demand.lastActivity = m_demandClock.elapsed();
+}
+
+void CameraManager::noteDemand(const QString &cameraUUID)
+{
+    if (!m_onDemand) return;
+
+    JanusConnector *connector = m_janusConnectors.value(cameraUUID);
     if (!connector) return;
 
-    // Find the camera UUID for this connector
-    for (auto it = m_janusConnectors.begin(); it != m_janusConnectors.end(); ++it) {
-        if (it.value() == connector) {
-            qDebug() << "Streaming started for camera:" << it.key();
-            emit streamingStarted(it.key());
-            break;
+    m_viewerDemand[cameraUUID].lastActivity = m_demandClock.elapsed();
+    connector->activateMountpoint();
+}
+
+bool CameraManager::hasViewers(const QString &cameraUUID) const
+{
+    auto it = m_viewerDemand.constFind(cameraUUID);
+    return it != m_viewerDemand.cend() && !it->viewers.isEmpty();
+}
+
+void CameraManager::sweepIdleMountpoints()
+{
+    const qint64 now = m_demandClock.elapsed();
+
+    for (auto it = m_viewerDemand.begin(); it != m_viewerDemand.end(); ) {
+        ViewerDemand &demand = it.value();
+
+        // Pages that stopped sending heartbeats without a leave beacon
+        for (auto viewer = demand.viewers.begin(); viewer != demand.viewers.end(); ) {
+            if (now - viewer.value() > ViewerTimeoutMs) {
+                viewer = demand.viewers.erase(viewer);
+            } else {
+                ++viewer;
+            }
         }
-        else {
-            qDebug() << "Stream not found";
+
+        if (!demand.viewers.isEmpty() || now - demand.lastActivity < m_idleTtlMs) {
+            ++it;
+            continue;
+        }
+
+        JanusConnector *connector = m_janusConnectors.value(it.key());
+        if (connector) connector->deactivateMountpoint();
+
+        // Still live (e.g. previewed locally): look again after another TTL
+        if (connector && connector->isConnected()) {
+            demand.lastActivity = now;
+            ++it;
+        } else {
+            it = m_viewerDemand.erase(it);
         }
     }
-    // qDebug() << "Streaming started for camera:" << m_currentCameraUUID;
-    // emit streamingStarted(m_currentCameraUUID);
 }
 
-void CameraManager::onStreamingStopped()
+void CameraManager::onJanusPluginEvent(qint64 sessionId, qint64 handleId, const QJsonObject &data)
 {
+    // Streaming plugin events name the mountpoint they are about
+    const int mountpointId = data["id"].toInt();
+    JanusConnector *connector = m_janusConnectors.value(m_mountpointCameras.value(mountpointId));
+
+    // The index can be stale after a connector was destroyed; check it
+    if (!connector || connector->mountpointId() != mountpointId) {
+        LOG_RATE_LIMITED(LogLevel::Debug, 20, "janus_plugin_event_unrouted")
+            .field("session", sessionId).field("handle", handleId).field("data", data);
+        return;
+    }
+    connector->handlePluginEvent(data);
+}
 
-    // Find which connector sent the signal**
+void CameraManager::onMountpointUpdated()
+{
     JanusConnector *connector = qobject_cast<JanusConnector*>(sender());
     if (!connector) return;
 
-    // Find the camera UUID for this connector
-    for (auto it = m_janusConnectors.begin(); it != m_janusConnectors.end(); ++it) {
-        if (it.value() == connector) {
-            qDebug() << "Streaming stopped for camera:" << it.key();
-            m_httpServer->unregisterStream(it.key());
-            emit streamingStopped(it.key());
-            break;
-        }
+    const QString cameraUUID = m_connectorCameras.value(connector);
+    if (cameraUUID.isEmpty()) return;
+
+    // Same mountpoint, new names on the page
+    const CameraParams params = connector->currentParams();
+    m_httpServer->registerStream(cameraUUID, params, connector->mountpointId(), m_janusUrl);
+    m_registryLog.append({ params, connector->mountpointId(), m_janusUrl });
+    LOG_INFO("mountpoint_updated").field("camera", cameraUUID).field("mountpoint", connector->mountpointId());
+
+    finishSetup(connector, true, QString());
+}
+
+void CameraManager::onMountpointUpdateFailed(const CameraParams &params, const QString &error, int pluginErrorCode)
+{
+    // 455 no such mountpoint: Janus lost it, and probably the others too.
+    // Recreate it with the new parameters once the retry is due.
+    JanusConnector *connector = qobject_cast<JanusConnector*>(sender());
+    if (connector && pluginErrorCode == 455) {
+        connector->markMountpointLost();
+        finishSetup(connector, false, error);
+        retryLater(connector, ProvisionAction::Created, params);
+        sessionPoolFor(connector->janusUrl())->mountpoints()->recheck();
+        return;
     }
 
-    // qDebug() << "Streaming stopped for camera:" << m_currentCameraUUID;
-    // emit streamingStopped(m_currentCameraUUID);
+    LOG_WARNING("mountpoint_edit_failed").field("camera", params.cameraUUID)
+        .field("error", error).field("plugin_error", pluginErrorCode);
+
+    // The plugin rejected the edit: older Janus versions cannot edit
+    // everything, so fall back to a new mountpoint
+    if (pluginErrorCode != 0 || !connector) {
+        provisionCamera(params, ProvisionAction::Recreated);
+        return;
+    }
+
+    // Timeouts, lost sessions and transport errors say nothing about the
+    // edit; recreating would cut every viewer. Try the edit again, or a
+    // create if the mountpoint went away meanwhile.
+    const bool up = connector->isConnected() || connector->isReserved();
+    finishSetup(connector, false, error);
+    retryLater(connector, up ? ProvisionAction::Updated : ProvisionAction::Created, params);
+}
+
+void CameraManager::onMountpointsLost(const QList<int> &mountpointIds)
+{
+    const MountpointCatalog *catalog = qobject_cast<const MountpointCatalog*>(sender());
+
+    for (int mountpointId : mountpointIds) {
+        JanusConnector *connector = m_janusConnectors.value(m_mountpointCameras.value(mountpointId));
+        if (!connector || connector->mountpointId() != mountpointId) continue;
+        if (sessionPoolFor(connector->janusUrl())->mountpoints() != catalog) continue;
+
+        // A setup in flight learns about it from its own request
+        if (!connector->isConnected() || m_setupsInFlight.contains(connector)) continue;
+
+        // Through the retry scheduler, so a node that lost every mountpoint
+        // is not hit with all of them at once and its breaker sees it
+        connector->markMountpointLost();
+        retryLater(connector, ProvisionAction::Created, connector->currentParams());
+    }
+}
+
+QString CameraManager::actionName(ProvisionAction action)
+{
+    switch (action) {
+    case ProvisionAction::Created:   return "created";
+    case ProvisionAction::Unchanged: return "unchanged";
+    case ProvisionAction::Updated:   return "updated";
+    case ProvisionAction::Recreated: return "recreated";
+    }
+    return QString();
+}
+
+void CameraManager::onStreamingStarted()
+{
+    const QString cameraUUID = m_connectorCameras.value(sender());
+    if (cameraUUID.isEmpty()) {
+        LOG_DEBUG("streaming_started_unknown");
+        return;
+    }
+
+    LOG_INFO("streaming_started").field("camera", cameraUUID);
+    emit streamingStarted(cameraUUID);
+}
+
+void CameraManager::onStreamingStopped()
+{
+    const QString cameraUUID = m_connectorCameras.value(sender());
+    if (cameraUUID.isEmpty()) return;
+
+    LOG_INFO("streaming_stopped").field("camera", cameraUUID);
+    m_httpServer->unregisterStream(cameraUUID);
+    emit streamingStopped(cameraUUID);
 }
 
 void CameraManager::onJanusError(const QString &error)
 {
-    qWarning() << "Janus error:" << error;
+    JanusConnector *connector = qobject_cast<JanusConnector*>(sender());
+    const bool setupFailed = connector && m_setupsInFlight.contains(connector);
+
+    finishSetup(sender(), false, error);
+
+    // A failed setup is not final: count it against the node and try again
+    if (setupFailed) retryLater(connector, ProvisionAction::Created, connector->currentParams());
+
+    LOG_RATE_LIMITED(LogLevel::Warning, 10, "janus_error")
+        .field("camera", m_connectorCameras.value(sender())).field("error", error);
     emit errorOccurred(QString("Janus error: %1").arg(error));
 }
 
+void CameraManager::retryLater(JanusConnector *connector, ProvisionAction action, const CameraParams &params)
+{
+    const QString cameraUUID = m_connectorCameras.value(connector);
+    if (cameraUUID.isEmpty()) return;
+
+    m_retries.insert(cameraUUID, { action, params });
+    m_retryScheduler->recordFailure(connector->janusUrl(), cameraUUID);
+    m_retryScheduler->schedule(cameraUUID);
+}
+
+void CameraManager::onRetryDue(const QString &cameraUUID)
+{
+    JanusConnector *connector = m_janusConnectors.value(cameraUUID);
+    auto retry = m_retries.constFind(cameraUUID);
+
+    // Gone, replaced, or brought up some other way since it failed. An
+    // edit needs the mountpoint up, anything else needs it down.
+    bool stale = !connector || retry == m_retries.cend()
+                 || m_setupsInFlight.contains(connector) || m_setupQueue.contains(cameraUUID);
+    if (!stale) {
+        const bool up = connector->isConnected() || connector->isReserved();
+        stale = (retry->action == ProvisionAction::Updated) ? !up : up;
+    }
+    if (stale) {
+        m_retries.remove(cameraUUID);
+        m_retryScheduler->cancel(cameraUUID);
+        return;
+    }
+
+    const InFlightSetup setup = *retry;
+    m_retries.erase(retry);
+    m_setupQueue.push(setup.params, setup.action, hasViewers(cameraUUID));
+    pumpSetupQueue();
+}
+
 void CameraManager::onHttpServerError(const QString &error)
 {
     qWarning() << "HTTP server error:" << error;
@@ -195,12 +718,22 @@ void CameraManager::onHttpServerError(const QString &error)
 // Cleanup when connector is destroyed
 void CameraManager::onConnectorDestroyed()
 {
-    // Remove destroyed connector from map
-    for (auto it = m_janusConnectors.begin(); it != m_janusConnectors.end(); ++it) {
-        if (it.value() == sender()) {
-            m_httpServer->unregisterStream(it.key());
-            m_janusConnectors.erase(it);
-            break;
-        }
+    // Only drop the camera if it still maps to this connector; a replaced
+    // connector was already removed from the index
+    const QString cameraUUID = m_connectorCameras.value(sender());
+    if (cameraUUID.isEmpty()) return;
+
+    // Destroyed mid-setup without a replacement: free the slot and report
+    if (m_setupsInFlight.contains(sender())) {
+        finishSetup(sender(), false, "Setup cancelled");
+    }
+    m_connectorCameras.remove(sender());
+
+    if (m_janusConnectors.value(cameraUUID) == sender()) {
+        m_httpServer->unregisterStream(cameraUUID);
+        m_janusConnectors.remove(cameraUUID);
+        m_retryScheduler->cancel(cameraUUID);
+        m_retries.remove(cameraUUID);
+        noteRestoreProgress(cameraUUID);
     }
 }
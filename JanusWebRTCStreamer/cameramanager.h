@@ -4,10 +4,20 @@
 
 #include <QObject>
 #include <QDebug>
-#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
 #include "httpserver.h"
 #include "janusconnector.h"
 #include "cameraparams.h"
+#include "previewprovider.h"
+#include "janussessionpool.h"
+#include "keepalivescheduler.h"
+#include "cameraregistrylog.h"
+#include "retryscheduler.h"
+#include "setupqueue.h"
 
 class CameraManager : public QObject
 {
@@ -21,8 +31,24 @@ public:
     void stopService();
 
     // Configuration
+    // http(s):// talks to Janus over REST, ws(s):// over one WebSocket
     void setJanusUrl(const QString &url);
     void setStreamCredentials(const QString &username, const QString &password);
+    // Local previews for startStreaming(); the GUI app passes its
+    // WebViewPool, the daemon leaves this unset. Set before cameras arrive.
+    void setPreviewProvider(PreviewProvider *provider);
+    // At most this many cameras go through Janus setup at once
+    void setMaxConcurrentSetups(int maxSetups);
+    // Cameras waiting for setup, in total and per customer; POSTs beyond
+    // that are refused with 503 or 429 and a Retry-After
+    void setSetupQueueLimits(int maxQueued, int maxQueuedPerCustomer);
+    const SetupQueue &setupQueue() const { return m_setupQueue; }
+    int setupsInFlight() const { return m_setupsInFlight.size(); }
+    // Where registered cameras are persisted; set before startService()
+    void setRegistryPath(const QString &path);
+    // Create mountpoints when the first viewer shows up and destroy them
+    // after idleTtlSeconds without viewers; set before startService()
+    void setOnDemandMountpoints(bool enabled, int idleTtlSeconds = 300);
 
 signals:
     void serviceStarted();
@@ -30,6 +56,9 @@ signals:
     void streamingStarted(const QString &cameraUUID);
     void streamingStopped(const QString &cameraUUID);
     void errorOccurred(const QString &error);
+    // action is "created", "unchanged", "updated" or "recreated"
+    void cameraSetupFinished(const QString &cameraUUID, bool success, const QString &error,
+                             const QString &action);
 
 private slots:
     void onCameraParametersReceived(const CameraParams &params);
@@ -39,11 +68,89 @@ private slots:
     void onHttpServerError(const QString &error);
     void onConnectorDestroyed();
     void onSessionReady(qint64 sessionId, qint64 handleId);
+    void onMountpointUpdated();
+    void onMountpointReserved();
+    void onStreamRequested(const QString &cameraUUID);
+    void onViewerActivity(const QString &cameraUUID, const QString &viewerId, bool leaving);
+    void sweepIdleMountpoints();
+    void onRetryDue(const QString &cameraUUID);
+    void onMountpointUpdateFailed(const CameraParams &params, const QString &error, int pluginErrorCode);
+    void onMountpointsLost(const QList<int> &mountpointIds);
+    void onJanusPluginEvent(qint64 sessionId, qint64 handleId, const QJsonObject &data);
 
 private:
+    // Viewers of one on-demand camera, by the ID their page made up
+    struct ViewerDemand {
+        QHash<QString, qint64> viewers;     // viewer -> last heartbeat
+        qint64 lastActivity = 0;
+    };
+
+    static QString actionName(ProvisionAction action);
+    void streamReady(JanusConnector *connector);
+    void noteDemand(const QString &cameraUUID);
+    bool hasViewers(const QString &cameraUUID) const;
+    void provisionCamera(const CameraParams &params, ProvisionAction action);
+    void addConnector(const QString &cameraUUID, JanusConnector *connector);
+    void removeConnector(const QString &cameraUUID);
+    JanusSessionPool *sessionPoolFor(const QString &janusUrl);
+    void pumpSetupQueue();
+    void restoreCameras();
+    void dropStaleRestoredPages();
+    void noteRestoreProgress(const QString &cameraUUID);
+    void finishRestore();
+    void finishSetup(const QObject *connector, bool success, const QString &error);
+    void retryLater(JanusConnector *connector, ProvisionAction action, const CameraParams &params);
+
     HttpServer *m_httpServer;
-    QMap<QString, JanusConnector*> m_janusConnectors;
+    QPointer<PreviewProvider> m_previewProvider;
+
+    // Bidirectional index so Janus callbacks resolve their camera in O(1).
+    // The reverse side is keyed by QObject* because it is also used from
+    // destroyed(), when the connector is no longer a JanusConnector.
+    QHash<QString, JanusConnector*> m_janusConnectors;
+    QHash<const QObject*, QString> m_connectorCameras;
     QString m_janusUrl;
+
+    // Keepalives for every pooled Janus session, on one timer
+    KeepAliveScheduler *m_keepAliveScheduler;
+
+    // One pool of shared Janus sessions per Janus server
+    QHash<QString, JanusSessionPool*> m_sessionPools;
+    // Routes plugin events from the shared handles back to their camera
+    QHash<int, QString> m_mountpointCameras;
+
+    // On-demand mountpoints
+    bool m_onDemand;
+    int m_idleTtlMs;
+    QHash<QString, ViewerDemand> m_viewerDemand;
+    QTimer *m_idleSweepTimer;
+    QElapsedTimer m_demandClock;
+
+    // Registered cameras survive restarts through this log
+    CameraRegistryLog m_registryLog;
+    // Restored cameras whose page is served before their setup, until the
+    // mountpoint catalog can tell whether the page's ID is still theirs
+    QHash<QString, CameraRecord> m_restoredPages;
+    // Restored cameras that have not tried to adopt their mountpoint yet;
+    // mountpoints left unclaimed after that are destroyed
+    QSet<QString> m_restoring;
+
+    // Setup pipeline: cameras wait here until a setup slot is free
+    SetupQueue m_setupQueue;
+    // What each in-flight setup is bringing its connector to; the
+    // connector's own params only change once it succeeds
+    struct InFlightSetup {
+        ProvisionAction action;
+        CameraParams params;
+    };
+    QHash<const QObject*, InFlightSetup> m_setupsInFlight;
+    int m_maxConcurrentSetups;
+    bool m_pumpingSetups;
+    bool m_pumpAgain;
+    // Failed setups come back through here, paced per Janus node
+    RetryScheduler *m_retryScheduler;
+    // What each scheduled retry sets up
+    QHash<QString, InFlightSetup> m_retries;
     //JanusConnector *m_janusConnector;
     //QString m_currentCameraUUID;
 };
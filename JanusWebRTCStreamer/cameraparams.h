@@ -2,6 +2,7 @@
 #define CAMERAPARAMS_H
 
 #include <QString>
+#include <QMetaType>
 
 
 struct CameraParams {
@@ -18,6 +19,21 @@ struct CameraParams {
     bool isValid() const {
         return !cameraUUID.isEmpty() && !ip.isEmpty();
     }
+
+    bool operator==(const CameraParams &other) const {
+        return cameraUUID == other.cameraUUID
+            && customerName == other.customerName
+            && applianceName == other.applianceName
+            && cameraId == other.cameraId
+            && roomName == other.roomName
+            && ip == other.ip
+            && rtspUrl == other.rtspUrl
+            && rtspUser == other.rtspUser
+            && rtspPassword == other.rtspPassword;
+    }
+    bool operator!=(const CameraParams &other) const { return !(*this == other); }
 };
 
+Q_DECLARE_METATYPE(CameraParams)
+
 #endif // CAMERAPARAMS_H
@@ -0,0 +1,203 @@
+#include "cameraregistrylog.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+// Superseded lines tolerated on top of the live ones before compacting
+const int CompactionSlack = 256;
+
+const QFileDevice::Permissions OwnerOnly = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+
+} // namespace
+
+CameraRegistryLog::CameraRegistryLog(const QString &path)
+    : m_path(path)
+    , m_logLines(0)
+{
+}
+
+CameraRegistryLog::~CameraRegistryLog()
+{
+    m_file.close();
+}
+
+void CameraRegistryLog::setPath(const QString &path)
+{
+    if (m_file.isOpen()) {
+        qWarning() << "Cannot change camera registry path after it was loaded";
+        return;
+    }
+    m_path = path;
+}
+
+QList<CameraRecord> CameraRegistryLog::load()
+{
+    m_live.clear();
+    m_logLines = 0;
+    bool damaged = false;
+
+    QFile file(m_path);
+    if (file.open(QIODevice::ReadOnly) && file.size() > 0) {
+        QByteArray fallback;
+        QByteArrayView data;
+        if (uchar *mapped = file.map(0, file.size())) {
+            data = QByteArrayView(mapped, file.size());
+        } else {
+            fallback = file.readAll();
+            data = fallback;
+        }
+
+        qsizetype start = 0;
+        while (start < data.size()) {
+            qsizetype end = data.indexOf('\n', start);
+            // No newline: the write of the last line never finished
+            if (end == -1) {
+                damaged = true;
+                break;
+            }
+
+            QByteArrayView line = data.sliced(start, end - start);
+            start = end + 1;
+
+            CameraRecord record;
+            if (!decode(line, &record)) {
+                qWarning() << "Skipping corrupt camera registry line";
+                damaged = true;
+                continue;
+            }
+            m_live.insert(record.params.cameraUUID, line.toByteArray());
+            m_logLines++;
+        }
+        // unmap happens when the file is closed
+    }
+    file.close();
+
+    QList<CameraRecord> records;
+    records.reserve(m_live.size());
+    for (const QByteArray &line : std::as_const(m_live)) {
+        CameraRecord record;
+        decode(line, &record);
+        records.append(record);
+    }
+
+    qDebug() << "Camera registry loaded" << records.size() << "cameras from" << m_logLines << "log lines";
+
+    // Also drops damaged lines before new ones are appended after them
+    if (damaged || m_logLines > m_live.size()) {
+        compact();
+    } else {
+        openForAppend();
+    }
+    return records;
+}
+
+bool CameraRegistryLog::append(const CameraRecord &record)
+{
+    const QByteArray line = encode(record);
+    auto it = m_live.find(record.params.cameraUUID);
+    if (it != m_live.end() && it.value() == line) return true;
+
+    if (!m_file.isOpen() && !openForAppend()) return false;
+
+    if (m_file.write(line + '\n') != line.size() + 1 || !m_file.flush()) {
+        qWarning() << "Failed to append to camera registry:" << m_file.errorString();
+        return false;
+    }
+
+    m_live.insert(record.params.cameraUUID, line);
+    m_logLines++;
+
+    if (m_logLines > m_live.size() * 2 + CompactionSlack) {
+        compact();
+    }
+    return true;
+}
+
+bool CameraRegistryLog::compact()
+{
+    m_file.close();
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+
+    // Written aside and renamed over the log, so a crash leaves either
+    // the old log or the new one
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to compact camera registry:" << file.errorString();
+        openForAppend();
+        return false;
+    }
+    file.setPermissions(OwnerOnly);
+
+    for (const QByteArray &line : std::as_const(m_live)) {
+        file.write(line);
+        file.write("\n", 1);
+    }
+    if (!file.commit()) {
+        qWarning() << "Failed to compact camera registry:" << file.errorString();
+        openForAppend();
+        return false;
+    }
+
+    m_logLines = m_live.size();
+    return openForAppend();
+}
+
+bool CameraRegistryLog::openForAppend()
+{
+    if (m_file.isOpen()) return true;
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Failed to open camera registry" << m_path << ":" << m_file.errorString();
+        return false;
+    }
+    // The log holds RTSP credentials
+    m_file.setPermissions(OwnerOnly);
+    return true;
+}
+
+QByteArray CameraRegistryLog::encode(const CameraRecord &record)
+{
+    const CameraParams &params = record.params;
+
+    QJsonObject obj;
+    obj["uuid"] = params.cameraUUID;
+    obj["customer"] = params.customerName;
+    obj["appliance"] = params.applianceName;
+    obj["camera"] = params.cameraId;
+    obj["room"] = params.roomName;
+    obj["ip"] = params.ip;
+    obj["url"] = params.rtspUrl;
+    obj["user"] = params.rtspUser;
+    obj["pwd"] = params.rtspPassword;
+    obj["mountpoint"] = record.mountpointId;
+    obj["janus"] = record.janusUrl;
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+bool CameraRegistryLog::decode(QByteArrayView line, CameraRecord *record)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromRawData(line.data(), line.size()));
+    if (!doc.isObject()) return false;
+
+    const QJsonObject obj = doc.object();
+    CameraParams &params = record->params;
+    params.cameraUUID = obj["uuid"].toString();
+    params.customerName = obj["customer"].toString();
+    params.applianceName = obj["appliance"].toString();
+    params.cameraId = obj["camera"].toString();
+    params.roomName = obj["room"].toString();
+    params.ip = obj["ip"].toString();
+    params.rtspUrl = obj["url"].toString();
+    params.rtspUser = obj["user"].toString();
+    params.rtspPassword = obj["pwd"].toString();
+    record->mountpointId = obj["mountpoint"].toInt();
+    record->janusUrl = obj["janus"].toString();
+    return params.isValid();
+}
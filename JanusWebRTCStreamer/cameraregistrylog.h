@@ -0,0 +1,55 @@
+#ifndef CAMERAREGISTRYLOG_H
+#define CAMERAREGISTRYLOG_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "cameraparams.h"
+
+struct CameraRecord {
+    CameraParams params;
+    int mountpointId = 0;
+    QString janusUrl;
+};
+
+// On-disk copy of the registered cameras and their mountpoints, so a
+// restarted service can serve stream pages before anyone re-POSTs them.
+// It is an append-only log of JSON lines, one per registration, where the
+// last line for a camera wins. Once superseded lines outnumber the live
+// ones the log is rewritten with one line per camera.
+class CameraRegistryLog
+{
+public:
+    explicit CameraRegistryLog(const QString &path = QString());
+    ~CameraRegistryLog();
+
+    // Only takes effect before load()
+    void setPath(const QString &path);
+    QString path() const { return m_path; }
+
+    // Maps the log and replays it. A torn last line (crash mid-append) is
+    // skipped. Opens the log for appending.
+    QList<CameraRecord> load();
+
+    // Records a registration; a record identical to the live one is not
+    // written again
+    bool append(const CameraRecord &record);
+    bool compact();
+
+    int cameraCount() const { return m_live.size(); }
+
+private:
+    static QByteArray encode(const CameraRecord &record);
+    static bool decode(QByteArrayView line, CameraRecord *record);
+    bool openForAppend();
+
+    QString m_path;
+    QFile m_file;
+    QHash<QString, QByteArray> m_live;   // camera UUID -> encoded line
+    int m_logLines;
+};
+
+#endif // CAMERAREGISTRYLOG_H
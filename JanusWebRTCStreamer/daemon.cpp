@@ -0,0 +1,124 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "cameramanager.h"
+#include "logger.h"
+#include "metrics.h"
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Headless camera streaming service: the same CameraManager as the GUI app
+// on a QCoreApplication, without Widgets, WebEngine or a local preview.
+//
+// Stream page credentials come from CAMSTREAM_STREAM_USER and
+// CAMSTREAM_STREAM_PASSWORD so they do not show up in the process list.
+
+namespace {
+
+#ifdef Q_OS_UNIX
+int s_signalSockets[2];
+
+void onTerminateSignal(int)
+{
+    // Only async-signal-safe work here; the notifier quits the event loop
+    const char byte = 1;
+    ssize_t written = ::write(s_signalSockets[0], &byte, 1);
+    Q_UNUSED(written)
+}
+
+// SIGTERM/SIGINT stop the event loop so the service shuts down cleanly
+void installTerminateHandler(QCoreApplication *app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, s_signalSockets) != 0) {
+        qWarning() << "Cannot watch for termination signals";
+        return;
+    }
+
+    QSocketNotifier *notifier = new QSocketNotifier(s_signalSockets[1], QSocketNotifier::Read, app);
+    QObject::connect(notifier, &QSocketNotifier::activated, app, &QCoreApplication::quit);
+
+    struct sigaction action = {};
+    action.sa_handler = onTerminateSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+}
+#endif
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QElapsedTimer startup;
+    startup.start();
+
+    // The core library is static; pull in its pages and scripts
+    Q_INIT_RESOURCE(resources);
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CameraStreamingDaemon");
+
+    Logger::global().setLevel(Logger::levelFromString(qgetenv("CAMSTREAM_LOG_LEVEL")));
+    Logger::global().start();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless camera streaming service");
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "HTTP port.", "port", "8080");
+    QCommandLineOption janusOption("janus-url", "Janus http(s):// or ws(s):// URL.", "url");
+    QCommandLineOption registryOption("registry", "Registered cameras file.", "path");
+    QCommandLineOption onDemandOption("on-demand", "Create mountpoints when the first viewer arrives.");
+    QCommandLineOption idleTtlOption("idle-ttl", "Seconds an on-demand mountpoint lives without viewers.",
+                                     "seconds", "300");
+    QCommandLineOption setupsOption("max-setups", "Camera setups in flight at once.", "count", "16");
+    parser.addOptions({ portOption, janusOption, registryOption, onDemandOption, idleTtlOption, setupsOption });
+    parser.process(app);
+
+#ifdef Q_OS_UNIX
+    installTerminateHandler(&app);
+#endif
+
+    int result = 0;
+    {
+        CameraManager cameraManager;
+
+        if (parser.isSet(janusOption)) cameraManager.setJanusUrl(parser.value(janusOption));
+        if (parser.isSet(registryOption)) cameraManager.setRegistryPath(parser.value(registryOption));
+        cameraManager.setOnDemandMountpoints(parser.isSet(onDemandOption), parser.value(idleTtlOption).toInt());
+        cameraManager.setMaxConcurrentSetups(parser.value(setupsOption).toInt());
+
+        const QByteArray user = qgetenv("CAMSTREAM_STREAM_USER");
+        if (!user.isEmpty()) {
+            cameraManager.setStreamCredentials(QString::fromUtf8(user),
+                                               QString::fromUtf8(qgetenv("CAMSTREAM_STREAM_PASSWORD")));
+        }
+
+        QObject::connect(&cameraManager, &CameraManager::errorOccurred, [](const QString &error) {
+            LOG_RATE_LIMITED(LogLevel::Warning, 10, "camera_manager_error").field("error", error);
+        });
+
+        const quint16 port = quint16(parser.value(portOption).toUInt());
+        if (!cameraManager.startService(port)) {
+            LOG_ERROR("service_start_failed").field("port", port);
+            Logger::global().stop();
+            return 1;
+        }
+
+        Metrics::global().startupMicros.set(startup.nsecsElapsed() / 1000);
+        LOG_INFO("service_started").field("port", port)
+            .field("startup_ms", startup.elapsed()).field("rss_bytes", Metrics::residentBytes());
+
+        result = app.exec();
+        LOG_INFO("service_stopping");
+    }
+
+    Logger::global().stop();
+    return result;
+}
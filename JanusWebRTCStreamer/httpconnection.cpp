@@ -0,0 +1,277 @@
+#include "httpconnection.h"
+#include "httpserver.h"
+#include "logger.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <utility>
+
+HttpConnection::HttpConnection(QTcpSocket *socket, HttpServer *server, const Settings &settings)
+    : QObject(socket)
+    , m_socket(socket)
+    , m_server(server)
+    , m_settings(settings)
+    , m_parser(settings.maxHeaderSize, settings.maxBodySize)
+    , m_idleTimer(new QTimer(this))
+    , m_setupResultTimer(new QTimer(this))
+    , m_requestCount(0)
+    , m_closeAfterResponse(false)
+    , m_closing(false)
+    , m_responseInProgress(false)
+    , m_route(Metrics::RouteOther)
+    , m_responseStatus(0)
+{
+    Metrics::global().httpConnections.add();
+    Metrics::global().httpOpenConnections.add();
+
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(m_settings.idleTimeoutMs);
+    connect(m_idleTimer, &QTimer::timeout, this, &HttpConnection::onIdleTimeout);
+
+    m_setupResultTimer->setSingleShot(true);
+    m_setupResultTimer->setInterval(m_settings.setupResultTimeoutMs);
+    connect(m_setupResultTimer, &QTimer::timeout, this, &HttpConnection::onSetupResultTimeout);
+
+    connect(m_socket, &QTcpSocket::readyRead, this, &HttpConnection::onReadyRead);
+    connect(m_socket, &QTcpSocket::disconnected, m_socket, &QTcpSocket::deleteLater);
+
+    m_idleTimer->start();
+}
+
+HttpConnection::~HttpConnection()
+{
+    Metrics::global().httpOpenConnections.sub();
+
+    if (!m_pendingSetups.isEmpty()) {
+        m_server->cancelSetupResults(this);
+    }
+}
+
+void HttpConnection::sendResponse(int statusCode, const QByteArray &statusText,
+                                  const QByteArray &headers, const QByteArray &body)
+{
+    if (m_closing) return;
+
+    const QByteArray response = serializeResponse(statusCode, statusText, headers, connectionHeaders(), body);
+    m_socket->write(response);
+
+    Metrics &metrics = Metrics::global();
+    metrics.httpBytesSent.add(response.size());
+    metrics.recordHttpRequest(m_route, statusCode, m_requestTimer.nsecsElapsed() / 1000);
+
+    if (m_closeAfterResponse) {
+        m_closing = true;
+        m_idleTimer->stop();
+        m_socket->disconnectFromHost();
+    }
+}
+
+QByteArray HttpConnection::serializeResponse(int statusCode, const QByteArray &statusText,
+                                             const QByteArray &headers, const QByteArray &connectionHeaders,
+                                             const QByteArray &body)
+{
+    QByteArray response;
+    response.reserve(192 + headers.size() + body.size());
+    response += "HTTP/1.1 " + QByteArray::number(statusCode) + ' ' + statusText + "\r\n";
+    response += headers;
+    if (statusCode != 204 && statusCode != 304) {
+        response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    }
+    response += connectionHeaders;
+    response += "\r\n";
+    response += body;
+    return response;
+}
+
+void HttpConnection::beginChunkedResponse(int statusCode, const QByteArray &statusText,
+                                          const QByteArray &headers)
+{
+    if (m_closing) return;
+
+    QByteArray response;
+    response += "HTTP/1.1 " + QByteArray::number(statusCode) + ' ' + statusText + "\r\n";
+    response += headers;
+    response += "Transfer-Encoding: chunked\r\n";
+    response += connectionHeaders();
+    response += "\r\n";
+
+    m_responseInProgress = true;
+    m_responseStatus = statusCode;
+    m_socket->write(response);
+    Metrics::global().httpBytesSent.add(response.size());
+}
+
+void HttpConnection::sendChunk(const QByteArray &data)
+{
+    if (m_closing || !m_responseInProgress || data.isEmpty()) return;
+
+    const QByteArray chunk = QByteArray::number(data.size(), 16) + "\r\n" + data + "\r\n";
+    m_socket->write(chunk);
+    Metrics::global().httpBytesSent.add(chunk.size());
+}
+
+void HttpConnection::endChunkedResponse()
+{
+    if (!m_responseInProgress) return;
+
+    m_responseInProgress = false;
+    if (!m_closing) {
+        m_socket->write("0\r\n\r\n");
+    }
+    // Streamed provisioning responses take as long as the setups behind them
+    Metrics::global().recordHttpRequest(m_route, m_responseStatus, m_requestTimer.nsecsElapsed() / 1000);
+    finishResponse();
+}
+
+void HttpConnection::expectSetupResults(const QStringList &cameraUUIDs)
+{
+    for (const QString &cameraUUID : cameraUUIDs) {
+        m_pendingSetups.insert(cameraUUID);
+    }
+    m_setupResultTimer->start();
+}
+
+void HttpConnection::deliverSetupResult(const QString &cameraUUID, const QByteArray &line)
+{
+    if (!m_pendingSetups.remove(cameraUUID)) return;
+
+    sendChunk(line + '\n');
+    if (m_pendingSetups.isEmpty()) {
+        m_setupResultTimer->stop();
+        endChunkedResponse();
+    }
+}
+
+void HttpConnection::onSetupResultTimeout()
+{
+    if (m_pendingSetups.isEmpty()) return;
+
+    // A setup can wait on Janus for a long time (retries, an open breaker);
+    // the client and this connection's pipeline don't wait with it. The
+    // setup itself goes on; a result posted meanwhile finds nothing pending.
+    m_server->cancelSetupResults(this);
+    const QSet<QString> timedOut = std::exchange(m_pendingSetups, {});
+    LOG_RATE_LIMITED(LogLevel::Warning, 5, "setup_result_timeout").field("cameras", timedOut.size());
+
+    for (const QString &cameraUUID : timedOut) {
+        QJsonObject result;
+        result["camera_id"] = cameraUUID;
+        result["status"] = "failed";
+        result["success"] = false;
+        result["error"] = "timeout";
+        sendChunk(QJsonDocument(result).toJson(QJsonDocument::Compact) + '\n');
+    }
+    endChunkedResponse();
+}
+
+QByteArray HttpConnection::connectionHeaders() const
+{
+    if (m_closeAfterResponse) {
+        return "Connection: close\r\n";
+    }
+    return "Connection: keep-alive\r\n"
+           "Keep-Alive: timeout=" + QByteArray::number(m_settings.idleTimeoutMs / 1000)
+         + ", max=" + QByteArray::number(m_settings.maxRequests - m_requestCount) + "\r\n";
+}
+
+void HttpConnection::finishResponse()
+{
+    if (m_closeAfterResponse) {
+        m_closing = true;
+        m_idleTimer->stop();
+        m_socket->disconnectFromHost();
+        return;
+    }
+
+    // Carry on with requests that were pipelined behind the streamed one
+    processRequests();
+}
+
+void HttpConnection::onReadyRead()
+{
+    if (m_closing) {
+        m_socket->readAll();
+        return;
+    }
+
+    m_parser.append(m_socket->readAll());
+    if (!m_responseInProgress) {
+        processRequests();
+        return;
+    }
+
+    // parse() enforces the limits, but it doesn't run while a response is
+    // streamed; more than one full request pipelined behind it is refused
+    if (m_parser.bufferedSize() > m_settings.maxHeaderSize + m_settings.maxBodySize) {
+        LOG_RATE_LIMITED(LogLevel::Warning, 10, "http_pipeline_overflow").field("buffered", m_parser.bufferedSize());
+        m_closing = true;
+        m_idleTimer->stop();
+        m_socket->disconnectFromHost();
+    }
+}
+
+void HttpConnection::onIdleTimeout()
+{
+    m_closing = true;
+    m_socket->disconnectFromHost();
+}
+
+void HttpConnection::processRequests()
+{
+    m_idleTimer->stop();
+
+    // Handle every complete request in the buffer. Handlers respond
+    // synchronously or stream a response, in which case the rest waits.
+    while (!m_closing && !m_responseInProgress) {
+        HttpRequestParser::Status status = m_parser.parse();
+        if (status == HttpRequestParser::NeedMoreData) break;
+
+        if (status != HttpRequestParser::RequestReady) {
+            // The stream can't be resynchronised after a framing error
+            m_closeAfterResponse = true;
+            m_route = Metrics::RouteOther;
+            m_requestTimer.start();
+            switch (status) {
+            case HttpRequestParser::HeadersTooLarge:
+                sendResponse(431, "Request Header Fields Too Large", "Content-Type: application/json\r\n",
+                             "Request headers too large");
+                break;
+            case HttpRequestParser::BodyTooLarge:
+                sendResponse(413, "Payload Too Large", "Content-Type: application/json\r\n",
+                             "Request body too large");
+                break;
+            case HttpRequestParser::NotImplemented:
+                sendResponse(501, "Not Implemented", "Content-Type: application/json\r\n",
+                             "Transfer-Encoding not supported");
+                break;
+            default:
+                sendResponse(400, "Bad Request", "Content-Type: application/json\r\n",
+                             "{\"error\":\"Invalid request format\"}");
+                break;
+            }
+            break;
+        }
+
+        HttpRequest request = m_parser.takeRequest();
+        m_requestCount++;
+        m_closeAfterResponse = !wantsKeepAlive(request) || m_requestCount >= m_settings.maxRequests;
+        m_route = Metrics::routeFor(request.method, request.path);
+        m_requestTimer.start();
+
+        m_server->handleRequest(this, request);
+    }
+
+    if (!m_closing && !m_responseInProgress) {
+        m_idleTimer->start();
+    }
+}
+
+bool HttpConnection::wantsKeepAlive(const HttpRequest &request) const
+{
+    QByteArray connection = request.header("connection").toLower();
+
+    // HTTP/1.1 is persistent by default, HTTP/1.0 only on request
+    if (request.version == "HTTP/1.0") {
+        return connection.contains("keep-alive");
+    }
+    return !connection.contains("close");
+}
@@ -0,0 +1,91 @@
+#ifndef HTTPCONNECTION_H
+#define HTTPCONNECTION_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QSet>
+#include <QElapsedTimer>
+#include "httprequestparser.h"
+#include "metrics.h"
+
+class HttpServer;
+
+// One persistent HTTP/1.1 client connection. Requests are parsed as bytes
+// arrive and handed to the server one at a time, so pipelined requests are
+// answered in the order they were sent. The connection stays open until the
+// client asks to close, the request cap is reached or it sits idle too long.
+class HttpConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Settings {
+        qsizetype maxHeaderSize = 16 * 1024;
+        qsizetype maxBodySize = 1024 * 1024;
+        int idleTimeoutMs = 15000;
+        int maxRequests = 100;
+        // Provisioning responses give up on cameras still setting up after this
+        int setupResultTimeoutMs = 60000;
+    };
+
+    // The connection is parented to the socket and goes away with it
+    HttpConnection(QTcpSocket *socket, HttpServer *server, const Settings &settings);
+    ~HttpConnection();
+
+    QTcpSocket *socket() const { return m_socket; }
+
+    // headers holds extra "Name: value\r\n" lines; Content-Length and
+    // Connection are added here
+    void sendResponse(int statusCode, const QByteArray &statusText,
+                      const QByteArray &headers, const QByteArray &body);
+
+    // The bytes sendResponse() writes, with connectionHeaders as the
+    // Connection/Keep-Alive lines
+    static QByteArray serializeResponse(int statusCode, const QByteArray &statusText,
+                                        const QByteArray &headers, const QByteArray &connectionHeaders,
+                                        const QByteArray &body);
+
+    // Streamed responses. Later pipelined requests wait until
+    // endChunkedResponse() so responses stay in order.
+    void beginChunkedResponse(int statusCode, const QByteArray &statusText,
+                              const QByteArray &headers);
+    void sendChunk(const QByteArray &data);
+    void endChunkedResponse();
+
+    // Bulk provisioning: the response streams one line per camera and
+    // ends once every expected camera has reported, or with a "timeout"
+    // line for each camera left after setupResultTimeoutMs
+    void expectSetupResults(const QStringList &cameraUUIDs);
+    void deliverSetupResult(const QString &cameraUUID, const QByteArray &line);
+
+private slots:
+    void onReadyRead();
+    void onIdleTimeout();
+    void onSetupResultTimeout();
+
+private:
+    void processRequests();
+    bool wantsKeepAlive(const HttpRequest &request) const;
+    QByteArray connectionHeaders() const;
+    void finishResponse();
+
+    QTcpSocket *m_socket;
+    HttpServer *m_server;
+    Settings m_settings;
+    HttpRequestParser m_parser;
+    QTimer *m_idleTimer;
+    QTimer *m_setupResultTimer;
+    int m_requestCount;
+    bool m_closeAfterResponse;
+    bool m_closing;
+    bool m_responseInProgress;
+    QSet<QString> m_pendingSetups;
+
+    // For the request being answered
+    QElapsedTimer m_requestTimer;
+    Metrics::Route m_route;
+    int m_responseStatus;
+};
+
+#endif // HTTPCONNECTION_H
@@ -0,0 +1,133 @@
+#include "httprequestparser.h"
+
+QByteArray HttpRequest::header(QByteArrayView name, const QByteArray &defaultValue) const
+{
+    for (const auto &header : headers) {
+        if (header.first == name) return header.second;
+    }
+    return defaultValue;
+}
+
+HttpRequestParser::HttpRequestParser(qsizetype maxHeaderSize, qsizetype maxBodySize)
+    : m_scanPos(0)
+    , m_bodyStart(0)
+    , m_contentLength(0)
+    , m_maxHeaderSize(maxHeaderSize)
+    , m_maxBodySize(maxBodySize)
+    , m_state(ReadingHeaders)
+    , m_failure(BadRequest)
+{
+}
+
+void HttpRequestParser::setLimits(qsizetype maxHeaderSize, qsizetype maxBodySize)
+{
+    m_maxHeaderSize = maxHeaderSize;
+    m_maxBodySize = maxBodySize;
+}
+
+void HttpRequestParser::append(const QByteArray &data)
+{
+    if (m_state == Failed) return;
+    m_buffer.append(data);
+}
+
+HttpRequestParser::Status HttpRequestParser::parse()
+{
+    if (m_state == Failed) return m_failure;
+    if (m_state == Complete) return RequestReady;
+
+    if (m_state == ReadingHeaders) {
+        // Resume a few bytes back in case the terminator straddled two reads
+        qsizetype headerEnd = m_buffer.indexOf("\r\n\r\n", qMax<qsizetype>(0, m_scanPos - 3));
+        if (headerEnd == -1) {
+            if (m_buffer.size() > m_maxHeaderSize) return fail(HeadersTooLarge);
+            m_scanPos = m_buffer.size();
+            return NeedMoreData;
+        }
+        if (headerEnd > m_maxHeaderSize) return fail(HeadersTooLarge);
+
+        Status status = parseHead(QByteArrayView(m_buffer).first(headerEnd));
+        if (status != NeedMoreData) return fail(status);
+
+        m_bodyStart = headerEnd + 4;
+        m_state = ReadingBody;
+    }
+
+    if (m_buffer.size() - m_bodyStart < m_contentLength) {
+        return NeedMoreData;
+    }
+
+    m_request.body = m_buffer.mid(m_bodyStart, m_contentLength);
+    m_state = Complete;
+    return RequestReady;
+}
+
+HttpRequest HttpRequestParser::takeRequest()
+{
+    HttpRequest request = std::move(m_request);
+
+    // Keep whatever follows this request (pipelining)
+    m_buffer.remove(0, m_bodyStart + m_contentLength);
+    m_request = HttpRequest();
+    m_scanPos = 0;
+    m_bodyStart = 0;
+    m_contentLength = 0;
+    m_state = ReadingHeaders;
+    return request;
+}
+
+HttpRequestParser::Status HttpRequestParser::parseHead(QByteArrayView head)
+{
+    // Request line: METHOD SP PATH SP VERSION
+    qsizetype lineEnd = head.indexOf("\r\n");
+    QByteArrayView requestLine = lineEnd == -1 ? head : head.first(lineEnd);
+
+    qsizetype firstSpace = requestLine.indexOf(' ');
+    qsizetype lastSpace = requestLine.lastIndexOf(' ');
+    if (firstSpace <= 0 || lastSpace <= firstSpace + 1) return BadRequest;
+
+    m_request.method = requestLine.first(firstSpace).toByteArray();
+    m_request.path = requestLine.sliced(firstSpace + 1, lastSpace - firstSpace - 1).toByteArray();
+    m_request.version = requestLine.sliced(lastSpace + 1).toByteArray();
+    if (!m_request.version.startsWith("HTTP/1.")) return BadRequest;
+
+    bool hasContentLength = false;
+    qsizetype pos = lineEnd == -1 ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        qsizetype end = head.indexOf("\r\n", pos);
+        if (end == -1) end = head.size();
+        QByteArrayView line = head.sliced(pos, end - pos);
+        pos = end + 2;
+
+        qsizetype colon = line.indexOf(':');
+        if (colon <= 0) return BadRequest;
+
+        QByteArray name = line.first(colon).trimmed().toByteArray().toLower();
+        QByteArray value = line.sliced(colon + 1).trimmed().toByteArray();
+
+        if (name == "content-length") {
+            bool ok = false;
+            qsizetype length = value.toLongLong(&ok);
+            if (!ok || length < 0) return BadRequest;
+            if (hasContentLength && length != m_contentLength) return BadRequest;
+            if (length > m_maxBodySize) return BodyTooLarge;
+            m_contentLength = length;
+            hasContentLength = true;
+        } else if (name == "transfer-encoding" && value.toLower() != "identity") {
+            // Chunked request bodies are not used by any of our clients
+            return NotImplemented;
+        }
+
+        m_request.headers.append(qMakePair(name, value));
+    }
+
+    return NeedMoreData;
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(Status status)
+{
+    m_state = Failed;
+    m_failure = status;
+    m_buffer.clear();
+    return status;
+}
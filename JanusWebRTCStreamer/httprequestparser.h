@@ -0,0 +1,71 @@
+#ifndef HTTPREQUESTPARSER_H
+#define HTTPREQUESTPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QPair>
+
+struct HttpRequest {
+    QByteArray method;
+    QByteArray path;
+    QByteArray version;
+    QList<QPair<QByteArray, QByteArray>> headers;   // names are lower-cased
+    QByteArray body;
+
+    QByteArray header(QByteArrayView name, const QByteArray &defaultValue = QByteArray()) const;
+};
+
+// Incremental HTTP/1.x request parser. Bytes are appended as they arrive and
+// parse() advances a small state machine, so a request split over several
+// readyRead events is buffered until the headers and the Content-Length body
+// are complete. Bytes past the end of a request stay buffered for the next one.
+class HttpRequestParser
+{
+public:
+    enum Status {
+        NeedMoreData,
+        RequestReady,
+        BadRequest,
+        HeadersTooLarge,
+        BodyTooLarge,
+        NotImplemented
+    };
+
+    explicit HttpRequestParser(qsizetype maxHeaderSize = 16 * 1024,
+                               qsizetype maxBodySize = 1024 * 1024);
+
+    void setLimits(qsizetype maxHeaderSize, qsizetype maxBodySize);
+
+    void append(const QByteArray &data);
+    Status parse();
+
+    // Valid after parse() returned RequestReady; resets for the next request
+    HttpRequest takeRequest();
+
+    bool hasBufferedData() const { return !m_buffer.isEmpty(); }
+    qsizetype bufferedSize() const { return m_buffer.size(); }
+
+private:
+    enum State {
+        ReadingHeaders,
+        ReadingBody,
+        Complete,
+        Failed
+    };
+
+    Status parseHead(QByteArrayView head);
+    Status fail(Status status);
+
+    QByteArray m_buffer;
+    qsizetype m_scanPos;        // where to resume looking for the header end
+    qsizetype m_bodyStart;
+    qsizetype m_contentLength;
+    qsizetype m_maxHeaderSize;
+    qsizetype m_maxBodySize;
+    State m_state;
+    Status m_failure;
+    HttpRequest m_request;
+};
+
+#endif // HTTPREQUESTPARSER_H
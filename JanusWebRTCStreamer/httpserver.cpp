@@ -1,12 +1,58 @@
 #include "httpserver.h"
 #include "janusconnector.h"
+#include "metrics.h"
+#include "logger.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QMessageAuthenticationCode>
+#include <QMutexLocker>
+#include <QJsonArray>
+#include <QRandomGenerator>
+#include <QSet>
+
+namespace {
+
+// A viewer grant outlives its page by this much without heartbeats; each
+// accepted beacon renews it
+const qint64 ViewerGrantLifetimeSec = 3600;
+const QByteArray ViewerGrantCookieName = "camstream_viewer";
+
+// Hands raw socket descriptors to the server instead of creating the
+// QTcpSocket here, so the socket can be created in a worker thread
+class HttpListener : public QTcpServer
+{
+public:
+    HttpListener(std::function<void(qintptr)> onConnection, QObject *parent)
+        : QTcpServer(parent)
+        , m_onConnection(std::move(onConnection))
+    {
+    }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        m_onConnection(socketDescriptor);
+    }
+
+private:
+    std::function<void(qintptr)> m_onConnection;
+};
+
+} // namespace
 
 HttpServer::HttpServer(QObject *parent)
     : QObject(parent)
-    , m_tcpServer(new QTcpServer(this))
+    , m_tcpServer(new HttpListener([this](qintptr descriptor) { dispatchConnection(descriptor); }, this))
+    , m_authEnabled(false)
+    , m_setupQueue(nullptr)
+    , m_workerCount(qBound(1, QThread::idealThreadCount() / 2, 4))
+    , m_nextWorker(0)
+    , m_inlineContext(nullptr)
 {
-    connect(m_tcpServer, &QTcpServer::newConnection,
-            this, &HttpServer::handleNewConnection);
+    m_viewerGrantKey.resize(32);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(m_viewerGrantKey.data()),
+                                          m_viewerGrantKey.size() / int(sizeof(quint32)));
+    loadStaticAssets();
 }
 
 HttpServer::~HttpServer()
@@ -29,8 +75,21 @@ bool HttpServer::startServer(quint16 port)
         return false;
     }
 
+    // Each worker runs its own event loop; sockets live and are served there
+    for (int i = 0; i < m_workerCount; i++) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("HttpWorker-%1").arg(i));
+        QObject *context = new QObject();
+        context->moveToThread(thread);
+        connect(thread, &QThread::finished, context, &QObject::deleteLater);
+        thread->start();
+        m_workers.append({ thread, context });
+    }
+    if (m_workers.isEmpty()) m_inlineContext = new QObject(this);
+
     //qDebug() << "HTTP server started on port:" << m_tcpServer->serverPort();
     qDebug() << "Stream URLs: http://localhost:" << port << "/stream/{uuid}";
+    qDebug() << "HTTP worker threads:" << m_workerCount;
     return true;
 }
 
@@ -41,9 +100,33 @@ void HttpServer::stopServer()
         qDebug() << "HTTP server stopped";
     }
 
+    // Open connections are children of the worker contexts and go with them
+    for (const Worker &worker : std::as_const(m_workers)) {
+        worker.thread->quit();
+        worker.thread->wait();
+        delete worker.thread;
+    }
+    m_workers.clear();
+    delete m_inlineContext;
+    m_inlineContext = nullptr;
+
     m_activeStreams.clear();
 }
 
+void HttpServer::setWorkerThreads(int count)
+{
+    if (m_tcpServer->isListening()) {
+        qWarning() << "Cannot change worker threads while listening";
+        return;
+    }
+    m_workerCount = qMax(0, count);
+}
+
+void HttpServer::setSetupQueue(const SetupQueue *queue)
+{
+    m_setupQueue = queue;
+}
+
 bool HttpServer::isListening() const
 {
     return m_tcpServer->isListening();
@@ -62,196 +145,436 @@ void HttpServer::registerStream(const QString &cameraUUID, const CameraParams &p
     info.mountpointId = mountpointId;
     info.janusUrl = janusUrl;
 
-    m_activeStreams[cameraUUID] = info;
-    qDebug() << "Stream registered:" << cameraUUID << "-> mountpoint" << mountpointId;
+    // Render the page once here instead of on every GET
+    info.page = templateloader::loadSimpleStreamTemplate(params, janusUrl,
+                                                         mountpointId, m_staticBaseUrl);
+    if (!info.page.isEmpty()) {
+        info.etag = '"' + QCryptographicHash::hash(info.page, QCryptographicHash::Sha1).toHex() + '"';
+    } else {
+        LOG_WARNING("stream_page_render_failed").field("camera", cameraUUID);
+    }
+
+    m_activeStreams.insert(cameraUUID, info);
+    LOG_DEBUG("stream_registered").field("camera", cameraUUID).field("mountpoint", mountpointId);
 }
 
 void HttpServer::unregisterStream(const QString &cameraUUID)
 {
     if (m_activeStreams.remove(cameraUUID)) {
-        qDebug() << "Stream unregistered:" << cameraUUID;
+        LOG_DEBUG("stream_unregistered").field("camera", cameraUUID);
     }
 }
 
-void HttpServer::handleNewConnection()
+void HttpServer::dispatchConnection(qintptr socketDescriptor)
 {
-    while (m_tcpServer->hasPendingConnections()) {
-        QTcpSocket *socket = m_tcpServer->nextPendingConnection();
-        connect(socket, &QTcpSocket::readyRead,
-                this, &HttpServer::handleClientRequest);
-        connect(socket, &QTcpSocket::disconnected,
-                socket, &QTcpSocket::deleteLater);
+    HttpConnection::Settings settings = m_connectionSettings;
+
+    auto accept = [this, socketDescriptor, settings](QObject *parent) {
+        QTcpSocket *socket = new QTcpSocket(parent);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            LOG_RATE_LIMITED(LogLevel::Warning, 5, "socket_adopt_failed").field("error", socket->errorString());
+            delete socket;
+            return;
+        }
+        new HttpConnection(socket, this, settings);
+    };
+
+    if (m_workers.isEmpty()) {
+        if (m_inlineContext) accept(m_inlineContext);
+        return;
     }
+
+    // Round-robin across workers; the socket is created in the worker thread
+    const Worker &worker = m_workers[m_nextWorker];
+    m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    QObject *context = worker.context;
+    QMetaObject::invokeMethod(context, [accept, context]() { accept(context); });
 }
 
-void HttpServer::handleClientRequest()
+void HttpServer::setRequestLimits(qsizetype maxHeaderSize, qsizetype maxBodySize)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) return;
+    m_connectionSettings.maxHeaderSize = maxHeaderSize;
+    m_connectionSettings.maxBodySize = maxBodySize;
+}
 
-    QByteArray requestData = socket->readAll();
-    QString request = QString::fromUtf8(requestData);
+void HttpServer::setKeepAlive(int idleTimeoutMs, int maxRequests)
+{
+    m_connectionSettings.idleTimeoutMs = idleTimeoutMs;
+    m_connectionSettings.maxRequests = qMax(1, maxRequests);
+}
 
-    qDebug() << "Received HTTP request:" << request.left(200) << "...";
+void HttpServer::setSetupResultTimeout(int timeoutMs)
+{
+    m_connectionSettings.setupResultTimeoutMs = qMax(1, timeoutMs);
+}
 
-    QMap<QString, QString> headers = parseHttpHeaders(request);
+void HttpServer::handleRequest(HttpConnection *connection, const HttpRequest &request)
+{
+    QString path = QString::fromUtf8(request.path);
+
+    LOG_DEBUG("http_request").field("method", request.method).field("path", path);
 
-    // Parse HTTP request
-    QStringList lines = request.split("\r\n");
-    if (lines.isEmpty()) {
-        socket->disconnectFromHost();
+    if (request.method == "GET") {
+        handleGetRequest(connection, path, request);
         return;
     }
 
-    QString requestLine = lines[0];
-    QStringList requestParts = requestLine.split(" ");
-
-    if (requestParts.size() < 3) {
-        sendHttpResponse(socket, 400, "Bad Request",
-                         "{\"error\":\"Invalid request format\"}");
+    // Existing POST handling logic
+    if (request.method != "POST") {
+        sendHttpResponse(connection, 405, "Method Not Allowed", "Only POST and GET methods are supported");
         return;
     }
 
-    QString method = requestParts[0];
-    QString path = requestParts[1];
-
-    if (method == "GET") {
-        handleGetRequest(socket, path, headers);
+    if (path == "/cameras") {
+        handleBulkCameraRequest(connection, request);
         return;
     }
 
-    // Existing POST handling logic
-    if (method != "POST") {
-        sendHttpResponse(socket, 405, "Method Not Allowed", "Only POST and GET methods are supported");
+    if (path.startsWith("/stream/") && path.endsWith("/viewer")) {
+        handleViewerBeacon(connection, path.mid(8, path.size() - 8 - 7), request);
         return;
     }
 
     if (!path.startsWith("/camera/")) {
-        sendHttpResponse(socket, 404, "Not Found", "Endpoint not found");
+        sendHttpResponse(connection, 404, "Not Found", "Endpoint not found");
         return;
     }
 
     QString uuid = path.mid(8); // Remove "/camera/"
     if (uuid.isEmpty()) {
-        sendHttpResponse(socket, 400, "Bad Request", "UUID required");
+        sendHttpResponse(connection, 400, "Bad Request", "UUID required");
         return;
     }
 
-    CameraParams params = parsePostRequest(request);
+    CameraParams params = parsePostRequest(request.body);
     if (params.cameraUUID.isEmpty()) {
-        sendHttpResponse(socket, 400, "Bad Request", "Invalid JSON or missing required fields");
+        sendHttpResponse(connection, 400, "Bad Request", "Invalid JSON or missing required fields");
         return;
     }
 
+    if (!admitSetups(connection, { params })) return;
+
+    // Answered once the camera is provisioned, with the path that was taken
+    connection->beginChunkedResponse(200, "OK", "Content-Type: application/json\r\n");
+    connection->expectSetupResults({ params.cameraUUID });
+    {
+        QMutexLocker locker(&m_setupWaitersMutex);
+        m_setupWaiters.insert(params.cameraUUID, connection);
+    }
+
     emit cameraParametersReceived(params);
-    sendHttpResponse(socket, 200, "OK", "Camera parameters received successfully");
 }
 
 
-void HttpServer::handleGetRequest(QTcpSocket *socket, const QString &path, const QMap<QString, QString> &headers)
+void HttpServer::handleGetRequest(HttpConnection *connection, const QString &path, const HttpRequest &request)
 {
-    if (path.startsWith("/stream/")) {
+    if (path.startsWith("/static/")) {
+        handleStaticRequest(connection, path, request);
+    } else if (path == "/metrics") {
+        handleMetricsRequest(connection, request);
+    } else if (path.startsWith("/stream/")) {
         QString cameraUUID = path.mid(8); // Remove "/stream/"
         if (cameraUUID.isEmpty()) {
-            sendHttpResponse(socket, 400, "Bad Request", "Camera UUID required");
+            sendHttpResponse(connection, 400, "Bad Request", "Camera UUID required");
             return;
         }
 
-        if (!m_activeStreams.contains(cameraUUID)) {
-            sendHttpResponse(socket, 404, "Not Found", "Stream not found or not active");
+        // Snapshot lookup that doesn't wait on writers; the entry stays valid while we hold it
+        StreamRegistry::StreamPtr streamInfo = m_activeStreams.find(cameraUUID);
+        if (!streamInfo) {
+            sendHttpResponse(connection, 404, "Not Found", "Stream not found or not active");
             return;
         }
 
-        if (m_authEnabled) {
-            QString authHeader = headers.value("authorization", "");
-            if (!checkBasicAuth(authHeader)) {
-                sendAuthRequired(socket);
-                return;
-            }
+        if (!checkBasicAuth(request.header("authorization"))) {
+            sendAuthRequired(connection);
+            return;
         }
 
-        const StreamInfo &streamInfo = m_activeStreams[cameraUUID];
-
-        qDebug() << "Loading stream template for camera:" << cameraUUID;
-
-        // Load Janus.js from resources
-        QFile janusFile(":/scripts/janus.js");
-        QString janusJsContent;
-        if (janusFile.open(QIODevice::ReadOnly)) {
-            janusJsContent = QString::fromUtf8(janusFile.readAll());
-            janusFile.close();
-        } else {
-            qWarning() << "Failed to load janus.js from resources";
-            sendHttpResponse(socket, 500, "Internal Server Error", "Janus script not found");
+        if (streamInfo->page.isEmpty()) {
+            sendHttpResponse(connection, 500, "Internal Server Error", "Template loading failed");
             return;
         }
 
-        // Use TemplateLoader to generate HTML content
-        QString htmlContent = templateloader::loadSimpleStreamTemplate(
-            streamInfo.params,
-            streamInfo.janusUrl,
-            streamInfo.mountpointId,
-            janusJsContent
-            );
-
+        // Someone is about to watch; on-demand mountpoints start now
+        emit streamRequested(cameraUUID);
 
-        if (htmlContent.isEmpty()) {
-            qWarning() << "Failed to load stream template";
-            sendHttpResponse(socket, 500, "Internal Server Error", "Template loading failed");
+        // The page's heartbeats carry this back to prove it was authorized
+        const QByteArray grant = viewerGrantCookie(cameraUUID);
+        if (etagMatches(request.header("if-none-match"), streamInfo->etag)) {
+            sendNotModified(connection, streamInfo->etag, grant);
             return;
         }
 
-        qDebug() << "Stream template loaded successfully for camera:" << cameraUUID;
-        sendHtmlResponse(socket, htmlContent);
+        sendHtmlResponse(connection, streamInfo->page, streamInfo->etag, grant);
     } else {
-        sendHttpResponse(socket, 404, "Not Found", "Page not found");
+        sendHttpResponse(connection, 404, "Not Found", "Page not found");
+    }
+}
+
+void HttpServer::handleMetricsRequest(HttpConnection *connection, const HttpRequest &request)
+{
+    if (!checkBasicAuth(request.header("authorization"))) {
+        sendAuthRequired(connection);
+        return;
+    }
+
+    QByteArray body;
+    Metrics::global().render(body);
+
+    if (m_setupQueue) {
+        writeMetricHeader(body, "camstream_setup_queue_depth", "Cameras waiting for a setup slot.", "gauge");
+        body += "camstream_setup_queue_depth " + QByteArray::number(m_setupQueue->size()) + '\n';
+        writeMetricHeader(body, "camstream_setup_queue_priority_depth",
+                          "Queued cameras with a viewer waiting.", "gauge");
+        body += "camstream_setup_queue_priority_depth " + QByteArray::number(m_setupQueue->priorityCount()) + '\n';
+        writeMetricHeader(body, "camstream_setup_queue_customers", "Customers with cameras queued.", "gauge");
+        body += "camstream_setup_queue_customers " + QByteArray::number(m_setupQueue->customerCount()) + '\n';
+        writeMetricHeader(body, "camstream_setup_queue_wait_seconds",
+                          "Moving average of the time setups spent queued.", "gauge");
+        body += "camstream_setup_queue_wait_seconds "
+              + QByteArray::number(double(m_setupQueue->averageWaitMs()) / 1000, 'f', 3) + '\n';
+        writeMetricHeader(body, "camstream_setup_queue_oldest_wait_seconds",
+                          "How long the longest-waiting queued camera has waited.", "gauge");
+        body += "camstream_setup_queue_oldest_wait_seconds "
+              + QByteArray::number(double(m_setupQueue->oldestWaitMs()) / 1000, 'f', 3) + '\n';
+    }
+
+    writeMetricHeader(body, "camstream_streams", "Streams with a page registered.", "gauge");
+    body += "camstream_streams " + QByteArray::number(m_activeStreams.size()) + '\n';
+
+    connection->sendResponse(200, "OK", "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n", body);
+}
+
+void HttpServer::handleViewerBeacon(HttpConnection *connection, const QString &cameraUUID, const HttpRequest &request)
+{
+    // Pages send these with navigator.sendBeacon, which cannot add an
+    // Authorization header; the grant cookie from the page request stands
+    // in for it. A beacon only keeps an existing stream warm.
+    if (!m_activeStreams.find(cameraUUID)) {
+        sendHttpResponse(connection, 404, "Not Found", "Stream not found or not active");
+        return;
+    }
+    if (!checkViewerGrant(cameraUUID, request.header("cookie"))) {
+        sendHttpResponse(connection, 403, "Forbidden", "Load the stream page first");
+        return;
+    }
+
+    QJsonObject beacon = QJsonDocument::fromJson(request.body).object();
+    const QString viewerId = beacon["viewer"].toString();
+    const QString event = beacon["event"].toString();
+    if (viewerId.isEmpty() || viewerId.size() > 64 || (event != "heartbeat" && event != "leave")) {
+        sendHttpResponse(connection, 400, "Bad Request", "Expected {\"viewer\": id, \"event\": \"heartbeat\"|\"leave\"}");
+        return;
+    }
+
+    emit viewerActivity(cameraUUID, viewerId, event == "leave");
+    connection->sendResponse(204, "No Content", viewerGrantCookie(cameraUUID), QByteArray());
+}
+
+QByteArray HttpServer::viewerGrantCookie(const QString &cameraUUID) const
+{
+    // "<expiry>.<mac>"; nothing is stored, the MAC ties it to the camera
+    const QByteArray expiry = QByteArray::number(QDateTime::currentSecsSinceEpoch() + ViewerGrantLifetimeSec);
+    const QByteArray mac = QMessageAuthenticationCode::hash(cameraUUID.toUtf8() + '|' + expiry, m_viewerGrantKey,
+                                                            QCryptographicHash::Sha256).toHex();
+    return "Set-Cookie: " + ViewerGrantCookieName + '=' + expiry + '.' + mac
+         + "; Path=/stream/" + cameraUUID.toUtf8() + "; Max-Age=" + QByteArray::number(ViewerGrantLifetimeSec)
+         + "; HttpOnly; SameSite=Strict\r\n";
+}
+
+bool HttpServer::checkViewerGrant(const QString &cameraUUID, const QByteArray &cookieHeader) const
+{
+    const QList<QByteArray> cookies = cookieHeader.split(';');
+    for (const QByteArray &cookie : cookies) {
+        const QByteArray trimmed = cookie.trimmed();
+        if (!trimmed.startsWith(ViewerGrantCookieName + '=')) continue;
+
+        const QByteArray grant = trimmed.mid(ViewerGrantCookieName.size() + 1);
+        const qsizetype dot = grant.indexOf('.');
+        if (dot <= 0) return false;
+
+        const QByteArray expiry = grant.left(dot);
+        if (expiry.toLongLong() < QDateTime::currentSecsSinceEpoch()) return false;
+
+        const QByteArray mac = QMessageAuthenticationCode::hash(cameraUUID.toUtf8() + '|' + expiry, m_viewerGrantKey,
+                                                                QCryptographicHash::Sha256).toHex();
+        return grant.mid(dot + 1) == mac;
     }
+    return false;
 }
 
-QMap<QString, QString> HttpServer::parseHttpHeaders(const QString &request)
+void HttpServer::handleBulkCameraRequest(HttpConnection *connection, const HttpRequest &request)
 {
-    QMap<QString, QString> headers;
-    QStringList lines = request.split("\r\n");
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(request.body, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isArray()) {
+        sendHttpResponse(connection, 400, "Bad Request", "{\"error\":\"Expected a JSON array of cameras\"}");
+        return;
+    }
 
-    // Skip the first line (request line)
-    for (int i = 1; i < lines.size(); i++) {
-        QString line = lines[i].trimmed();
-        if (line.isEmpty()) break; // End of headers
+    // Validate everything before anything is queued
+    const QJsonArray cameras = doc.array();
+    QList<CameraParams> accepted;
+    QStringList cameraUUIDs;
+    QSet<QString> seen;
+    QJsonArray errors;
+    accepted.reserve(cameras.size());
+
+    for (qsizetype i = 0; i < cameras.size(); i++) {
+        QString error;
+        CameraParams params;
+        if (!cameras[i].isObject()) {
+            error = "Camera entry must be an object";
+        } else {
+            params = cameraParamsFromJson(cameras[i].toObject());
+            if (!params.isValid()) {
+                error = "Missing camera_id or ip";
+            } else if (seen.contains(params.cameraUUID)) {
+                error = "Duplicate camera_id";
+            }
+        }
 
-        int colonPos = line.indexOf(':');
-        if (colonPos > 0) {
-            QString key = line.left(colonPos).trimmed().toLower();
-            QString value = line.mid(colonPos + 1).trimmed();
-            headers[key] = value;
+        if (!error.isEmpty()) {
+            QJsonObject entry;
+            entry["index"] = int(i);
+            entry["error"] = error;
+            errors.append(entry);
+            continue;
         }
+
+        seen.insert(params.cameraUUID);
+        cameraUUIDs.append(params.cameraUUID);
+        accepted.append(params);
+    }
+
+    if (!errors.isEmpty()) {
+        QJsonObject body;
+        body["errors"] = errors;
+        sendHttpResponse(connection, 400, "Bad Request", QJsonDocument(body).toJson(QJsonDocument::Compact));
+        return;
     }
 
-    return headers;
+    if (accepted.isEmpty()) {
+        sendHttpResponse(connection, 200, "OK", "");
+        return;
+    }
+
+    if (!admitSetups(connection, accepted)) return;
+
+    // Results stream back as NDJSON, one line per camera as it completes.
+    // Register before emitting so no result can slip past.
+    connection->beginChunkedResponse(200, "OK", "Content-Type: application/x-ndjson\r\n");
+    connection->expectSetupResults(cameraUUIDs);
+    {
+        QMutexLocker locker(&m_setupWaitersMutex);
+        for (const QString &cameraUUID : std::as_const(cameraUUIDs)) {
+            m_setupWaiters.insert(cameraUUID, connection);
+        }
+    }
+
+    LOG_INFO("bulk_provisioning").field("cameras", accepted.size());
+    for (const CameraParams &params : std::as_const(accepted)) {
+        emit cameraParametersReceived(params);
+    }
+}
+
+bool HttpServer::admitSetups(HttpConnection *connection, const QList<CameraParams> &cameras)
+{
+    if (!m_setupQueue) return true;
+
+    QHash<QString, int> customerCounts;
+    for (const CameraParams &params : cameras) {
+        customerCounts[params.customerName]++;
+    }
+
+    const SetupQueue::Admission admission = m_setupQueue->admit(customerCounts);
+    if (admission == SetupQueue::Admitted) return true;
+
+    // Queue full for everyone is overload (503); one customer over its
+    // share is that customer's problem (429)
+    const int retryAfter = m_setupQueue->retryAfterSeconds();
+    Metrics::global().setupsRefused.add(cameras.size());
+    QJsonObject body;
+    body["error"] = admission == SetupQueue::QueueFull
+                        ? "Setup queue is full"
+                        : "Too many cameras queued for this customer";
+    body["queue_depth"] = m_setupQueue->size();
+    body["retry_after"] = retryAfter;
+
+    const QByteArray headers = "Content-Type: application/json\r\nRetry-After: "
+                               + QByteArray::number(retryAfter) + "\r\n";
+    if (admission == SetupQueue::QueueFull) {
+        connection->sendResponse(503, "Service Unavailable", headers, QJsonDocument(body).toJson(QJsonDocument::Compact));
+    } else {
+        connection->sendResponse(429, "Too Many Requests", headers, QJsonDocument(body).toJson(QJsonDocument::Compact));
+    }
+
+    LOG_RATE_LIMITED(LogLevel::Warning, 5, "setup_refused")
+        .field("cameras", cameras.size()).field("reason", body["error"].toString());
+    return false;
+}
+
+void HttpServer::reportCameraSetupResult(const QString &cameraUUID, bool success, const QString &error,
+                                         const QString &action)
+{
+    QJsonObject result;
+    result["camera_id"] = cameraUUID;
+    result["status"] = success ? "ready" : "failed";
+    result["action"] = action;
+    if (!error.isEmpty()) {
+        result["error"] = error;
+    }
+    QByteArray line = QJsonDocument(result).toJson(QJsonDocument::Compact);
+
+    // Connections remove themselves under this lock before they go away,
+    // so every pointer here is alive while the call is posted
+    QMutexLocker locker(&m_setupWaitersMutex);
+    const QList<HttpConnection*> waiters = m_setupWaiters.values(cameraUUID);
+    m_setupWaiters.remove(cameraUUID);
+    for (HttpConnection *connection : waiters) {
+        QMetaObject::invokeMethod(connection, [connection, cameraUUID, line]() {
+            connection->deliverSetupResult(cameraUUID, line);
+        });
+    }
 }
 
-CameraParams HttpServer::parsePostRequest(const QString &request)
+void HttpServer::cancelSetupResults(HttpConnection *connection)
+{
+    QMutexLocker locker(&m_setupWaitersMutex);
+    for (auto it = m_setupWaiters.begin(); it != m_setupWaiters.end(); ) {
+        if (it.value() == connection) {
+            it = m_setupWaiters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+CameraParams HttpServer::parsePostRequest(const QByteArray &body)
 {
     CameraParams params;
 
-    // Find JSON body
-    int bodyStart = request.indexOf("\r\n\r\n");
-    if (bodyStart == -1) {
-        qWarning() << "No body found in request";
+    if (body.isEmpty()) {
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "camera_request_empty");
         return params;
     }
 
-    QString jsonBody = request.mid(bodyStart + 4);
-
     // Parse JSON
     QJsonParseError parseError;
-    QJsonDocument doc = QJsonDocument::fromJson(jsonBody.toUtf8(), &parseError);
+    QJsonDocument doc = QJsonDocument::fromJson(body, &parseError);
 
     if (parseError.error != QJsonParseError::NoError) {
-        qWarning() << "JSON parse error:" << parseError.errorString();
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "camera_request_invalid").field("error", parseError.errorString());
         return params;
     }
 
-    QJsonObject jsonObj = doc.object();
+    return cameraParamsFromJson(doc.object());
+}
+
+CameraParams HttpServer::cameraParamsFromJson(const QJsonObject &jsonObj)
+{
+    CameraParams params;
 
     // Extract parameters
     params.cameraUUID = jsonObj["camera_id"].toString();
@@ -277,42 +600,112 @@ CameraParams HttpServer::parsePostRequest(const QString &request)
     return params;
 }
 
-void HttpServer::sendHttpResponse(QTcpSocket *socket, int statusCode,
+void HttpServer::sendHttpResponse(HttpConnection *connection, int statusCode,
                                   const QString &statusText, const QByteArray &body)
 {
-    QString response = QString(
-                           "HTTP/1.1 %1 %2\r\n"
-                           "Content-Type: application/json\r\n"
-                           "Content-Length: %3\r\n"
-                           "Connection: close\r\n"
-                           "\r\n"
-                           ).arg(statusCode).arg(statusText).arg(body.size());
+    connection->sendResponse(statusCode, statusText.toUtf8(),
+                             "Content-Type: application/json\r\n", body);
+}
+
+void HttpServer::sendHtmlResponse(HttpConnection *connection, const QByteArray &body, const QByteArray &etag,
+                                  const QByteArray &extraHeaders)
+{
+    connection->sendResponse(200, "OK",
+                             "Content-Type: text/html; charset=utf-8\r\n"
+                             "Cache-Control: no-cache\r\n"
+                             "ETag: " + etag + "\r\n" + extraHeaders,
+                             body);
+    Metrics::global().pageBytesServed.add(body.size());
+}
+
+void HttpServer::sendNotModified(HttpConnection *connection, const QByteArray &etag,
+                                 const QByteArray &extraHeaders)
+{
+    connection->sendResponse(304, "Not Modified",
+                             "Cache-Control: no-cache\r\n"
+                             "ETag: " + etag + "\r\n" + extraHeaders,
+                             QByteArray());
+}
+
+bool HttpServer::etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag)
+{
+    if (ifNoneMatch.isEmpty() || etag.isEmpty()) return false;
+
+    // If-None-Match uses weak comparison, so a W/ prefix still matches
+    const QList<QByteArray> candidates = ifNoneMatch.split(',');
+    for (const QByteArray &candidate : candidates) {
+        QByteArrayView tag = QByteArrayView(candidate).trimmed();
+        if (tag == "*") return true;
+        if (tag.startsWith("W/")) tag = tag.sliced(2);
+        if (tag == etag) return true;
+    }
+    return false;
+}
+
+void HttpServer::handleStaticRequest(HttpConnection *connection, const QString &path, const HttpRequest &request)
+{
+    // Expected form: /static/<hash>/<name>
+    QStringList parts = path.mid(8).section('?', 0, 0).split('/');
+    if (parts.size() != 2 || parts[0].toLatin1() != m_staticHash) {
+        sendHttpResponse(connection, 404, "Not Found", "Asset not found");
+        return;
+    }
+
+    auto it = m_staticAssets.constFind(parts[1]);
+    if (it == m_staticAssets.constEnd()) {
+        sendHttpResponse(connection, 404, "Not Found", "Asset not found");
+        return;
+    }
+
+    // The URL changes whenever the bundle does, so the response never goes stale
+    QByteArray etag = '"' + m_staticHash + '"';
+    if (etagMatches(request.header("if-none-match"), etag)) {
+        sendNotModified(connection, etag);
+        return;
+    }
 
-    socket->write(response.toUtf8());
-    socket->write(body);
-    socket->disconnectFromHost();
+    const StaticAsset &asset = it.value();
+    connection->sendResponse(200, "OK",
+                             "Content-Type: " + asset.contentType + "\r\n"
+                             "Cache-Control: public, max-age=31536000, immutable\r\n"
+                             "ETag: " + etag + "\r\n",
+                             asset.body);
 }
 
-void HttpServer::sendHtmlResponse(QTcpSocket *socket, const QString &htmlContent)
+void HttpServer::loadStaticAssets()
 {
-    QByteArray body = htmlContent.toUtf8();
+    static const struct {
+        const char *name;
+        const char *resource;
+        const char *contentType;
+    } assets[] = {
+        { "adapter.js",       ":/scripts/adapter.js",       "application/javascript; charset=utf-8" },
+        { "janus.js",         ":/scripts/janus.js",         "application/javascript; charset=utf-8" },
+        { "simple_stream.js", ":/scripts/simple_stream.js", "application/javascript; charset=utf-8" },
+    };
+
+    QCryptographicHash bundleHash(QCryptographicHash::Sha1);
+    for (const auto &asset : assets) {
+        QFile file(asset.resource);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Failed to load static asset:" << asset.resource;
+            continue;
+        }
 
-    QString response = QString(
-                           "HTTP/1.1 200 OK\r\n"
-                           "Content-Type: text/html; charset=utf-8\r\n"
-                           "Content-Length: %1\r\n"
-                           "Connection: close\r\n"
-                           "\r\n")
-                           .arg(body.size());
+        StaticAsset entry;
+        entry.body = file.readAll();
+        entry.contentType = asset.contentType;
+        bundleHash.addData(entry.body);
+        m_staticAssets.insert(asset.name, entry);
+    }
 
-    socket->write(response.toUtf8());
-    socket->write(body);
-    socket->flush(); // make sure it’s sent immediately
-    socket->disconnectFromHost();
+    m_staticHash = bundleHash.result().toHex().left(16);
+    m_staticBaseUrl = QString("/static/%1").arg(QString::fromLatin1(m_staticHash));
 }
 
 void HttpServer::setCredentials(const QString &username, const QString &password)
 {
+    QMutexLocker locker(&m_stateMutex);
     m_username = username;
     m_password = password;
     m_authEnabled = !username.isEmpty() && !password.isEmpty();
@@ -321,35 +714,33 @@ void HttpServer::setCredentials(const QString &username, const QString &password
 
 bool HttpServer::isValidCredentials(const QString &username, const QString &password) const
 {
+    QMutexLocker locker(&m_stateMutex);
     return (username == m_username && password == m_password);
 }
 
-bool HttpServer::checkBasicAuth(const QString &authHeader) const
+bool HttpServer::checkBasicAuth(const QByteArray &authHeader) const
 {
-    if (!m_authEnabled) return true;
+    {
+        QMutexLocker locker(&m_stateMutex);
+        if (!m_authEnabled) return true;
+    }
 
     if (!authHeader.startsWith("Basic ")) return false;
 
-    QString encoded = authHeader.mid(6); // Remove "Basic "
-    QByteArray decoded = QByteArray::fromBase64(encoded.toUtf8());
-    QString credentials = QString::fromUtf8(decoded);
+    QByteArray decoded = QByteArray::fromBase64(authHeader.mid(6)); // Remove "Basic "
 
-    QStringList parts = credentials.split(":");
-    if (parts.size() != 2) return false;
+    // The user name cannot contain ':', the password can
+    qsizetype colon = decoded.indexOf(':');
+    if (colon == -1) return false;
 
-    return isValidCredentials(parts[0], parts[1]);
+    return isValidCredentials(QString::fromUtf8(decoded.left(colon)),
+                              QString::fromUtf8(decoded.mid(colon + 1)));
 }
 
-void HttpServer::sendAuthRequired(QTcpSocket *socket)
+void HttpServer::sendAuthRequired(HttpConnection *connection)
 {
-    QString response = "HTTP/1.1 401 Unauthorized\r\n";
-    response += "WWW-Authenticate: Basic realm=\"Stream Access\"\r\n";
-    response += "Content-Type: text/html; charset=utf-8\r\n";
-    response += "Content-Length: 47\r\n";
-    response += "Connection: close\r\n\r\n";
-    response += "<html><body><h1>401 Unauthorized</h1></body></html>";
-
-    socket->write(response.toUtf8());
-    socket->flush();
-    socket->disconnectFromHost();
+    connection->sendResponse(401, "Unauthorized",
+                             "WWW-Authenticate: Basic realm=\"Stream Access\"\r\n"
+                             "Content-Type: text/html; charset=utf-8\r\n",
+                             "<html><body><h1>401 Unauthorized</h1></body></html>");
 }
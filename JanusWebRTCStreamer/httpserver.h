@@ -9,7 +9,15 @@
 #include <QObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QThread>
+#include <QMutex>
+#include <QMultiHash>
+#include <functional>
 #include "cameraparams.h"
+#include "httprequestparser.h"
+#include "httpconnection.h"
+#include "streamregistry.h"
+#include "setupqueue.h"
 
 class HttpServer : public QObject
 {
@@ -29,40 +37,111 @@ public:
 
     void setCredentials(const QString &username, const QString &password);
     bool isValidCredentials(const QString &username, const QString &password) const;
-    QMap<QString, QString> parseHttpHeaders(const QString &request);
+    // True when auth is off or authHeader carries valid Basic credentials
+    bool checkBasicAuth(const QByteArray &authHeader) const;
+
+    // Camera parameters from a POST /camera body; invalid params on error
+    static CameraParams parsePostRequest(const QByteArray &body);
+
+    // Requests with larger headers get a 431, larger bodies a 413
+    void setRequestLimits(qsizetype maxHeaderSize, qsizetype maxBodySize);
+    // Persistent connections close after idleTimeoutMs without a request
+    // or once they have served maxRequests
+    void setKeepAlive(int idleTimeoutMs, int maxRequests);
+    // Provisioning requests answer "timeout" for cameras whose setup has
+    // not finished after this long
+    void setSetupResultTimeout(int timeoutMs);
+
+    // Connections are served by this many worker threads, each with its own
+    // event loop; 0 serves them on the server's thread. Applies on start.
+    void setWorkerThreads(int count);
+
+    // Provisioning requests that do not fit in queue are refused up front
+    void setSetupQueue(const SetupQueue *queue);
+
+public slots:
+    // Sends the outcome to any provisioning request waiting on it
+    void reportCameraSetupResult(const QString &cameraUUID, bool success, const QString &error,
+                                 const QString &action);
 
 signals:
+    // Emitted from worker threads; receivers get it queued on their thread
     void cameraParametersReceived(const CameraParams &params);
     void serverError(const QString &error);
-
-private slots:
-    void handleNewConnection();
-    void handleClientRequest();
+    // A stream page was served (200 or 304)
+    void streamRequested(const QString &cameraUUID);
+    // Heartbeat or leave beacon from a page that is showing the stream,
+    // with a viewer grant from its page request
+    void viewerActivity(const QString &cameraUUID, const QString &viewerId, bool leaving);
 
 private:
-    void sendHttpResponse(QTcpSocket *socket,
+    friend class HttpConnection;
+    void dispatchConnection(qintptr socketDescriptor);
+    void handleRequest(HttpConnection *connection, const HttpRequest &request);
+    void handleViewerBeacon(HttpConnection *connection, const QString &cameraUUID, const HttpRequest &request);
+
+    void sendHttpResponse(HttpConnection *connection,
                           int statusCode,
                           const QString &statusText,
                           const QByteArray &body);
 
-    void sendHtmlResponse(QTcpSocket *socket, const QString &htmlContent);
-    CameraParams parsePostRequest(const QString &request);
-    void handleGetRequest(QTcpSocket *socket, const QString &path, const QMap<QString, QString> &headers);
+    void sendHtmlResponse(HttpConnection *connection, const QByteArray &body, const QByteArray &etag,
+                          const QByteArray &extraHeaders = QByteArray());
+    void sendNotModified(HttpConnection *connection, const QByteArray &etag,
+                         const QByteArray &extraHeaders = QByteArray());
+    static bool etagMatches(const QByteArray &ifNoneMatch, const QByteArray &etag);
+    void handleStaticRequest(HttpConnection *connection, const QString &path, const HttpRequest &request);
+    static CameraParams cameraParamsFromJson(const QJsonObject &jsonObj);
+    void handleBulkCameraRequest(HttpConnection *connection, const HttpRequest &request);
+    bool admitSetups(HttpConnection *connection, const QList<CameraParams> &cameras);
+    void cancelSetupResults(HttpConnection *connection);
+    void handleGetRequest(HttpConnection *connection, const QString &path, const HttpRequest &request);
+    void handleMetricsRequest(HttpConnection *connection, const HttpRequest &request);
+
+    void sendAuthRequired(HttpConnection *connection);
 
-    bool checkBasicAuth(const QString &authHeader) const;
-    void sendAuthRequired(QTcpSocket *socket);
+    // Viewer beacons are only accepted with the grant cookie an
+    // authenticated stream page request hands out
+    QByteArray viewerGrantCookie(const QString &cameraUUID) const;
+    bool checkViewerGrant(const QString &cameraUUID, const QByteArray &cookieHeader) const;
+
+    void loadStaticAssets();
 
     QTcpServer *m_tcpServer;
 
-    struct StreamInfo {
-        CameraParams params;
-        int mountpointId;
-        QString janusUrl;
+    StreamRegistry m_activeStreams;
+
+    // Scripts served from the qrc under /static/<hash>/<name>
+    struct StaticAsset {
+        QByteArray body;
+        QByteArray contentType;
     };
-    QMap<QString, StreamInfo> m_activeStreams;
+    QHash<QString, StaticAsset> m_staticAssets;
+    QByteArray m_staticHash;     // content hash of the whole bundle
+    QString m_staticBaseUrl;     // "/static/<hash>"
     QString m_username;
     QString m_password;
     bool m_authEnabled;
+    mutable QMutex m_stateMutex;    // guards the credentials
+    QByteArray m_viewerGrantKey;    // signs viewer grants, fixed for the process
+
+    HttpConnection::Settings m_connectionSettings;
+
+    const SetupQueue *m_setupQueue;
+
+    // Bulk requests waiting for per-camera setup results
+    QMultiHash<QString, HttpConnection*> m_setupWaiters;
+    QMutex m_setupWaitersMutex;
+
+    struct Worker {
+        QThread *thread;
+        QObject *context;       // lives in thread, parents its sockets
+    };
+    QList<Worker> m_workers;
+    // Parents the connections served on this thread when there are no workers
+    QObject *m_inlineContext;
+    int m_workerCount;
+    int m_nextWorker;
 };
 
 #endif // HTTPSERVER_H
@@ -1,34 +1,85 @@
 #include "janusconnector.h"
-
-int JanusConnector::s_nextMountpointId = 1;
+#include "metrics.h"
+#include "logger.h"
 
 JanusConnector::JanusConnector(QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
-    , m_webView(new QWebEngineView())
-    , m_webChannel(new QWebChannel(this))
-    , m_keepAliveTimer(new QTimer(this))
+    , m_previewing(false)
     , m_janusUrl("http://10.10.205.65:8088/janus")
     , m_sessionId(0)
     , m_handleId(0)
     , m_state(Idle)
-    , m_currentReply(nullptr)
-    , m_mountpointId(s_nextMountpointId++)
+    , m_onDemand(false)
+    , m_mountpointId(0)
+    , m_preferredMountpointId(0)
 {
-    // Setup network manager
-    m_networkManager->setTransferTimeout(10000);// 10 seconds
-
-    // Setup keep-alive timer
-    m_keepAliveTimer->setInterval(30000); // 30 seconds
-    connect(m_keepAliveTimer, &QTimer::timeout, this, &JanusConnector::sendKeepAlive);
-
-    setupWebEngineView();
+    Metrics::global().connectorStateChanged(-1, m_state);
 }
 
 JanusConnector::~JanusConnector()
 {
     cleanup();
-    delete m_webView;
+    Metrics::global().connectorStateChanged(m_state, -1);
+}
+
+void JanusConnector::setState(State state)
+{
+    static_assert(Streaming + 1 == Metrics::ConnectorStateCount, "Metrics::ConnectorState mirrors State");
+
+    if (state == m_state) return;
+    Metrics::global().connectorStateChanged(m_state, state);
+    m_state = state;
+}
+
+void JanusConnector::setPreviewProvider(PreviewProvider *provider)
+{
+    if (m_previewing) {
+        qWarning() << "Cannot change preview provider while previewing";
+        return;
+    }
+    m_previewProvider = provider;
+}
+
+void JanusConnector::setSessionPool(JanusSessionPool *pool)
+{
+    if (m_state != Idle) {
+        qWarning() << "Cannot change session pool while connected";
+        return;
+    }
+    m_sessionPool = pool;
+}
+
+void JanusConnector::setOnDemand(bool onDemand)
+{
+    if (m_state != Idle) {
+        qWarning() << "Cannot change on-demand mode while connected";
+        return;
+    }
+    m_onDemand = onDemand;
+}
+
+void JanusConnector::activateMountpoint()
+{
+    if (m_state != Reserved || !m_sessionPool) return;
+
+    LOG_INFO("mountpoint_activating").field("camera", m_currentParams.cameraUUID).field("mountpoint", m_mountpointId);
+    createRTSPMountpoint();
+}
+
+void JanusConnector::deactivateMountpoint()
+{
+    // A local preview counts as a viewer
+    if (m_state != Ready || !m_sessionPool) return;
+
+    LOG_INFO("mountpoint_deactivating").field("camera", m_currentParams.cameraUUID).field("mountpoint", m_mountpointId);
+    sendDestroy();
+    m_sessionPool->mountpoints()->markDestroyed(m_mountpointId, m_currentParams.cameraUUID);
+
+    // The ID stays ours for the next viewer
+    m_sessionId = 0;
+    m_handleId = 0;
+    setState(Reserved);
+    emit connectionStateChanged(false);
 }
 
 void JanusConnector::setJanusUrl(const QString &url)
@@ -58,17 +109,96 @@ void JanusConnector::connectToJanus(const CameraParams &params)
     }
 
     m_currentParams = params;
-    qDebug() << "Connecting to Janus for camera:" << params.cameraUUID;
-    qDebug() << "RTSP URL:" << params.rtspUrl;
-    qDebug() << "Using mountpoint ID:" << m_mountpointId;
+    LOG_DEBUG("camera_connecting").field("camera", params.cameraUUID).field("rtsp_url", params.rtspUrl);
+
+    if (!m_sessionPool) {
+        emit errorOccurred("No Janus session pool");
+        return;
+    }
+
+    // Which mountpoints already exist is only known after reconciliation
+    MountpointCatalog *catalog = m_sessionPool->mountpoints();
+    if (!catalog->isReady()) {
+        setState(CreatingMountpoint);
+        connect(catalog, &MountpointCatalog::ready,
+                this, &JanusConnector::provisionMountpoint, Qt::SingleShotConnection);
+        connect(catalog, &MountpointCatalog::reconcileFailed,
+                this, &JanusConnector::onCatalogFailed, Qt::SingleShotConnection);
+        catalog->reconcile();
+        return;
+    }
+    provisionMountpoint();
+}
+
+void JanusConnector::provisionMountpoint()
+{
+    if (!m_sessionPool) {
+        setState(Idle);
+        emit errorOccurred("No Janus session pool");
+        return;
+    }
+
+    MountpointCatalog *catalog = m_sessionPool->mountpoints();
+    QObject::disconnect(catalog, &MountpointCatalog::reconcileFailed, this, nullptr);
+
+    // A mountpoint for this camera survived on Janus: take it over as is
+    int adopted = catalog->adopt(m_currentParams);
+    if (adopted > 0) {
+        // An ID left from an earlier failed create, or held since the
+        // restart, is not needed any more
+        if (m_mountpointId > 0) catalog->release(m_mountpointId);
+        if (m_preferredMountpointId != adopted) {
+            catalog->unreserve(m_preferredMountpointId, m_currentParams.cameraUUID);
+        }
+        m_preferredMountpointId = 0;
+        m_mountpointId = adopted;
+        setState(Ready);
+        LOG_INFO("mountpoint_adopted").field("camera", m_currentParams.cameraUUID).field("mountpoint", m_mountpointId);
+
+        // Adopted mountpoints are not tied to any of our sessions. Reported
+        // from the event loop: this runs inside the setup pump or the
+        // catalog's ready(), and completing there would re-enter them.
+        // An idle sweep may deactivate it first; that still completes setup.
+        QMetaObject::invokeMethod(this, [this, adopted]() {
+            if (m_state == Idle || m_mountpointId != adopted) return;
+            emit sessionReady(0, 0);
+            emit connectionStateChanged(true);
+        }, Qt::QueuedConnection);
+        return;
+    }
 
-    createJanusSession();
+    // A retry after a failed create keeps the ID it was given, and a
+    // restored camera recreates its mountpoint under the ID its page has
+    if (m_mountpointId <= 0) {
+        if (m_preferredMountpointId > 0
+            && catalog->claimReserved(m_preferredMountpointId, m_currentParams.cameraUUID)) {
+            m_mountpointId = m_preferredMountpointId;
+        } else {
+            m_mountpointId = catalog->allocateId();
+        }
+        m_preferredMountpointId = 0;
+        LOG_DEBUG("mountpoint_allocated").field("camera", m_currentParams.cameraUUID).field("mountpoint", m_mountpointId);
+    }
+
+    if (m_onDemand) {
+        // Queued for the same reason as an adopted mountpoint above
+        setState(Reserved);
+        const int reserved = m_mountpointId;
+        QMetaObject::invokeMethod(this, [this, reserved]() {
+            if (m_state != Reserved || m_mountpointId != reserved) return;
+            emit mountpointReserved();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // Sessions and handles are shared, so setup is a single request
+    createRTSPMountpoint();
 }
 
 void JanusConnector::disconnect()
 {
     cleanup();
-    m_state = Idle;
+    setState(Idle);
     emit connectionStateChanged(false);
 }
 
@@ -99,195 +229,156 @@ void JanusConnector::startStreaming()
 void JanusConnector::stopStreaming()
 {
     if (m_state == Streaming) {
-        m_webView->hide();
-        m_state = Ready;
+        releasePreview();
+        setState(Ready);
         emit streamingStopped();
     }
 }
 
-void JanusConnector::createJanusSession()
+void JanusConnector::createRTSPMountpoint()
 {
-    m_state = CreatingSession;
-
-    QJsonObject sessionRequest;
-    sessionRequest["janus"] = "create";
-    sessionRequest["transaction"] = "tx-create-session";
-
-    QJsonDocument doc(sessionRequest);
-    QNetworkRequest request((QUrl(m_janusUrl)));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    setState(CreatingMountpoint);
 
-    m_currentReply = m_networkManager->post(request, doc.toJson());
-    connect(m_currentReply, &QNetworkReply::finished,
-            this, &JanusConnector::onSessionCreated);
-    connect(m_currentReply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred),
-            this, &JanusConnector::onNetworkError);
+    m_currentTransaction = m_sessionPool->sendStreamingRequest(mountpointCreateRequest(m_currentParams, m_mountpointId));
+    connect(m_currentTransaction, &JanusTransaction::succeeded,
+            this, &JanusConnector::onMountpointCreated);
+    connect(m_currentTransaction, &JanusTransaction::failed,
+            this, &JanusConnector::onRequestFailed);
 }
 
-void JanusConnector::onSessionCreated()
+QJsonObject JanusConnector::mountpointCreateRequest(const CameraParams &params, int mountpointId)
 {
-    if (!m_currentReply) return;
-
-    QByteArray response = m_currentReply->readAll();
-    m_currentReply->deleteLater();
-    m_currentReply = nullptr;
-
-    qDebug() << "Session Create Response:" << response;
+    QJsonObject body;
+    body["request"] = "create";
+    body["type"] = "rtsp";
+    body["id"] = mountpointId;
+    body["name"] = params.roomName;
+    body["description"] = MountpointCatalog::descriptionFor(params);
+    body["audio"] = true;
+    body["video"] = true;
+    body["permanent"] = false;
+    body["url"] = params.rtspUrl;
+    body["metadata"] = MountpointCatalog::metadataFor(params);
 
-    QJsonParseError parseError;
-    QJsonDocument doc = QJsonDocument::fromJson(response, &parseError);
+    // RTSP parameters
+    body["rtsp_user"] = params.rtspUser;
+    body["rtsp_pwd"] = params.rtspPassword;
+    body["rtsp_reconnect_delay"] = 5;
+    body["rtsp_session_timeout"] = 0;
+    body["rtsp_timeout"] = 10;
+    body["rtsp_conn_timeout"] = 5;
+    return body;
+}
 
-    if (parseError.error != QJsonParseError::NoError) {
-        emit errorOccurred("Failed to parse session response");
-        m_state = Idle;
-        return;
-    }
+void JanusConnector::removeMountpoint()
+{
+    if (!m_sessionPool) return;
 
-    QJsonObject obj = doc.object();
-    if (obj["janus"].toString() != "success") {
-        emit errorOccurred("Failed to create Janus session");
-        m_state = Idle;
+    if (m_state == Reserved) {
+        m_sessionPool->mountpoints()->release(m_mountpointId);
         return;
     }
+    if (!isConnected()) return;
 
-    m_sessionId = obj["data"].toObject()["id"].toVariant().toLongLong();
-    qDebug() << "Session ID:" << m_sessionId;
-
-    // Start keep-alive timer
-    m_keepAliveTimer->start();
-
-    // Proceed to attach plugin
-    attachToStreamingPlugin();
+    sendDestroy();
+    m_sessionPool->mountpoints()->release(m_mountpointId);
 }
 
-void JanusConnector::attachToStreamingPlugin()
+void JanusConnector::sendDestroy()
 {
-    m_state = AttachingPlugin;
-
-    QJsonObject attachRequest;
-    attachRequest["janus"] = "attach";
-    attachRequest["plugin"] = "janus.plugin.streaming";
-    attachRequest["transaction"] = "tx-attach-plugin";
-
-    QJsonDocument doc(attachRequest);
-    QString url = QString("%1/%2").arg(m_janusUrl).arg(m_sessionId);
-    QNetworkRequest request((QUrl(url)));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-    m_currentReply = m_networkManager->post(request, doc.toJson());
-    connect(m_currentReply, &QNetworkReply::finished,
-            this, &JanusConnector::onPluginAttached);
-    connect(m_currentReply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred),
-            this, &JanusConnector::onNetworkError);
+    QJsonObject body;
+    body["request"] = "destroy";
+    body["id"] = m_mountpointId;
+    body["permanent"] = false;
+
+    // Fire and forget; the pool cleans the transaction up
+    JanusTransaction *transaction = m_sessionPool->sendStreamingRequest(body);
+    const int mountpointId = m_mountpointId;
+    QPointer<MountpointCatalog> catalog = m_sessionPool->mountpoints();
+    connect(transaction, &JanusTransaction::failed, transaction, [transaction, catalog, mountpointId](const QString &error) {
+        LOG_RATE_LIMITED(LogLevel::Warning, 10, "mountpoint_destroy_failed")
+            .field("mountpoint", mountpointId).field("error", error);
+        // 455 no such mountpoint: Janus may have lost the others as well
+        if (transaction->pluginErrorCode() == 455 && catalog) catalog->recheck();
+    });
 }
 
-void JanusConnector::onPluginAttached()
+void JanusConnector::updateMountpoint(const CameraParams &params)
 {
-    if (!m_currentReply) return;
-
-    QByteArray response = m_currentReply->readAll();
-    m_currentReply->deleteLater();
-    m_currentReply = nullptr;
-
-    qDebug() << "Plugin Attach Response:" << response;
-
-    QJsonParseError parseError;
-    QJsonDocument doc = QJsonDocument::fromJson(response, &parseError);
-
-    if (parseError.error != QJsonParseError::NoError) {
-        emit errorOccurred("Failed to parse attach response");
-        m_state = Idle;
+    // Nothing on Janus yet; the next activation uses the new parameters
+    if (m_state == Reserved) {
+        m_currentParams = params;
+        emit mountpointUpdated();
         return;
     }
 
-    QJsonObject obj = doc.object();
-    if (obj["janus"].toString() != "success") {
-        emit errorOccurred("Failed to attach to streaming plugin");
-        m_state = Idle;
+    if (!m_sessionPool || !isConnected()) {
+        emit updateFailed(params, "Mountpoint is not ready", 0);
         return;
     }
 
-    m_handleId = obj["data"].toObject()["id"].toVariant().toLongLong();
-    qDebug() << "Handle ID:" << m_handleId;
-
-    // Proceed to create mountpoint
-    createRTSPMountpoint();
-}
-
-void JanusConnector::createRTSPMountpoint()
-{
-    m_state = CreatingMountpoint;
-
     QJsonObject body;
-    body["request"] = "create";
-    body["type"] = "rtsp";
-    body["id"] = m_mountpointId;;
-    body["name"] = m_currentParams.roomName;
-    body["description"] = QString("%1 - %2 Live Stream")
-                              .arg(m_currentParams.customerName, m_currentParams.applianceName);
-    body["audio"] = true;
-    body["video"] = true;
+    body["request"] = "edit";
+    body["id"] = m_mountpointId;
+    body["new_description"] = MountpointCatalog::descriptionFor(params);
+    body["new_metadata"] = MountpointCatalog::metadataFor(params);
+    if (params.rtspUser != m_currentParams.rtspUser || params.rtspPassword != m_currentParams.rtspPassword) {
+        body["new_rtsp_username"] = params.rtspUser;
+        body["new_rtsp_password"] = params.rtspPassword;
+    }
     body["permanent"] = false;
-    body["url"] = m_currentParams.rtspUrl;
-    body["metadata"] = QString("Camera: %1, Room: %2, School: %3")
-                           .arg(m_currentParams.cameraId, m_currentParams.roomName,
-                                m_currentParams.applianceName);
-
-    // RTSP parameters
-    body["rtsp_user"] = m_currentParams.rtspUser;
-    body["rtsp_pwd"] = m_currentParams.rtspPassword;
-    body["rtsp_reconnect_delay"] = 5;
-    body["rtsp_session_timeout"] = 0;
-    body["rtsp_timeout"] = 10;
-    body["rtsp_conn_timeout"] = 5;
-
-    QJsonObject mountpointRequest;
-    mountpointRequest["janus"] = "message";
-    mountpointRequest["transaction"] = "tx-create-mountpoint";
-    mountpointRequest["session_id"] = m_sessionId;
-    mountpointRequest["handle_id"] = m_handleId;
-    mountpointRequest["body"] = body;
-
-    QJsonDocument doc(mountpointRequest);
-    QString url = QString("%1/%2/%3").arg(m_janusUrl).arg(m_sessionId).arg(m_handleId);
-    QNetworkRequest request((QUrl(url)));
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
-    m_currentReply = m_networkManager->post(request, doc.toJson());
-    connect(m_currentReply, &QNetworkReply::finished,
-            this, &JanusConnector::onMountpointCreated);
-    connect(m_currentReply, QOverload<QNetworkReply::NetworkError>::of(&QNetworkReply::errorOccurred),
-            this, &JanusConnector::onNetworkError);
+    JanusTransaction *transaction = m_sessionPool->sendStreamingRequest(body);
+    m_currentTransaction = transaction;
+    connect(transaction, &JanusTransaction::succeeded, this, [this, params]() {
+        m_currentTransaction = nullptr;
+        m_currentParams = params;
+        if (m_sessionPool) m_sessionPool->mountpoints()->recordCreated(m_mountpointId, params);
+        emit mountpointUpdated();
+    });
+    connect(transaction, &JanusTransaction::failed, this, [this, transaction, params](const QString &error) {
+        m_currentTransaction = nullptr;
+        emit updateFailed(params, error, transaction->pluginErrorCode());
+    });
 }
 
-void JanusConnector::onMountpointCreated()
+void JanusConnector::markMountpointLost()
 {
-    if (!m_currentReply) return;
+    if (!isConnected()) return;
 
-    QByteArray response = m_currentReply->readAll();
-    m_currentReply->deleteLater();
-    m_currentReply = nullptr;
+    LOG_WARNING("mountpoint_lost").field("camera", m_currentParams.cameraUUID).field("mountpoint", m_mountpointId);
 
-    qDebug() << "Mountpoint Create Response:" << response;
+    // A preview of it shows nothing any more
+    releasePreview();
+    if (m_sessionPool) m_sessionPool->mountpoints()->markDestroyed(m_mountpointId, m_currentParams.cameraUUID);
 
-    QJsonParseError parseError;
-    QJsonDocument doc = QJsonDocument::fromJson(response, &parseError);
+    m_sessionId = 0;
+    m_handleId = 0;
+    setState(Idle);
+    emit connectionStateChanged(false);
+}
 
-    if (parseError.error != QJsonParseError::NoError) {
-        emit errorOccurred("Failed to parse mountpoint response");
-        m_state = Idle;
+void JanusConnector::handlePluginEvent(const QJsonObject &data)
+{
+    if (data.contains("error_code")) {
+        emit errorOccurred(QString("Mountpoint %1 error %2: %3")
+                               .arg(m_mountpointId).arg(data["error_code"].toInt()).arg(data["error"].toString()));
         return;
     }
 
-    QJsonObject obj = doc.object();
-    if (obj["janus"].toString() != "success") {
-        emit errorOccurred("Failed to create RTSP mountpoint");
-        m_state = Idle;
-        return;
-    }
+    LOG_DEBUG("mountpoint_event").field("mountpoint", m_mountpointId).field("data", data);
+}
+
+void JanusConnector::onMountpointCreated(const QJsonObject &data, qint64 sessionId, qint64 handleId)
+{
+    m_currentTransaction = nullptr;
 
-    m_state = Ready;
-    qDebug() << "RTSP mountpoint created successfully";
+    m_sessionId = sessionId;
+    m_handleId = handleId;
+    setState(Ready);
+    if (m_sessionPool) m_sessionPool->mountpoints()->recordCreated(m_mountpointId, m_currentParams);
+    LOG_DEBUG("mountpoint_created").field("camera", m_currentParams.cameraUUID)
+        .field("mountpoint", m_mountpointId).field("data", data);
 
     emit sessionReady(m_sessionId, m_handleId);
     emit connectionStateChanged(true);
@@ -307,9 +398,9 @@ void JanusConnector::startWebRTCStreaming()
 
     // Load janus.js from resources**
     QFile janusFile(":/scripts/janus.js");
-    QString janusJsContent;
+    QByteArray janusJsContent;
     if (janusFile.open(QIODevice::ReadOnly)) {
-        janusJsContent = QString::fromUtf8(janusFile.readAll());
+        janusJsContent = janusFile.readAll();
         janusFile.close();
     } else {
         qWarning() << "Failed to load janus.js from resources";
@@ -318,7 +409,7 @@ void JanusConnector::startWebRTCStreaming()
     }
 
     // Use template loader to generate HTML content**
-    QString htmlContent = templateloader::loadStreamTemplate(
+    QByteArray htmlContent = templateloader::loadStreamTemplate(
         m_currentParams,
         m_janusUrl,
         m_mountpointId,
@@ -330,76 +421,68 @@ void JanusConnector::startWebRTCStreaming()
         return;
     }
 
-    m_webView->setHtml(htmlContent);
-    m_webView->show();
+    if (!m_previewProvider) {
+        emit errorOccurred("Local preview is not available in this build");
+        return;
+    }
+    if (!m_previewProvider->showPreview(this, QString::fromUtf8(htmlContent))) {
+        emit errorOccurred("No preview view available");
+        return;
+    }
+    m_previewing = true;
 
-    m_state = Streaming;
+    setState(Streaming);
     emit streamingStarted();
 }
 
-void JanusConnector::setupWebEngineView()
+void JanusConnector::releasePreview()
 {
-    m_webView->resize(1280, 720);
-    m_webView->setWindowTitle("Janus WebRTC Stream");
-
-    QWebEngineSettings *settings = m_webView->page()->settings();
-    settings->setAttribute(QWebEngineSettings::JavascriptEnabled, true);
-    settings->setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls, true);
-    settings->setAttribute(QWebEngineSettings::AllowRunningInsecureContent, true);
-
-    m_webView->setContextMenuPolicy(Qt::DefaultContextMenu);
+    if (!m_previewing) return;
 
-    m_webView->page()->setWebChannel(m_webChannel);
-    m_webChannel->registerObject("qtConnector", this);
-}
-
-void JanusConnector::sendKeepAlive()
-{
-    if (m_sessionId > 0) {
-        QJsonObject keepAlive;
-        keepAlive["janus"] = "keepalive";
-        keepAlive["session_id"] = m_sessionId;
-        keepAlive["transaction"] = QString("tx-keepalive-%1")
-                                       .arg(QDateTime::currentMSecsSinceEpoch());
-
-        QJsonDocument doc(keepAlive);
-        QNetworkRequest request(QUrl(QString("%1/%2").arg(m_janusUrl).arg(m_sessionId)));
-        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-
-        QNetworkReply *reply = m_networkManager->post(request, doc.toJson());
-        connect(reply, &QNetworkReply::finished, reply, &QNetworkReply::deleteLater);
-    }
+    if (m_previewProvider) m_previewProvider->hidePreview(this);
+    m_previewing = false;
 }
 
 void JanusConnector::cleanup()
 {
-    m_keepAliveTimer->stop();
-
-    if (m_currentReply) {
-        m_currentReply->abort();
-        m_currentReply->deleteLater();
-        m_currentReply = nullptr;
+    // The pool owns the transaction; just stop listening to it
+    if (m_currentTransaction) {
+        QObject::disconnect(m_currentTransaction, nullptr, this, nullptr);
+        m_currentTransaction = nullptr;
     }
 
-    if (m_webView) {
-        m_webView->hide();
+    if (m_sessionPool) {
+        MountpointCatalog *catalog = m_sessionPool->mountpoints();
+        QObject::disconnect(catalog, nullptr, this, nullptr);
+        // The mountpoint stays on Janus for whoever registers this camera next
+        if (m_mountpointId > 0) catalog->unclaim(m_mountpointId);
     }
 
+    releasePreview();
+
     m_sessionId = 0;
     m_handleId = 0;
 }
 
-void JanusConnector::onNetworkError(QNetworkReply::NetworkError error)
+void JanusConnector::onRequestFailed(const QString &error)
 {
-    qDebug() << "Network error:" << error;
+    m_currentTransaction = nullptr;
 
-    if (m_currentReply) {
-        qDebug() << "Error string:" << m_currentReply->errorString();
-        m_currentReply->deleteLater();
-        m_currentReply = nullptr;
-    }
+    LOG_RATE_LIMITED(LogLevel::Warning, 10, "janus_request_failed")
+        .field("camera", m_currentParams.cameraUUID).field("error", error);
+
+    emit errorOccurred(QString("Failed to create RTSP mountpoint: %1").arg(error));
+    // On demand the ID stays reserved and the next viewer retries
+    setState((m_onDemand && m_mountpointId > 0) ? Reserved : Idle);
+    emit connectionStateChanged(false);
+}
+
+void JanusConnector::onCatalogFailed(const QString &error)
+{
+    if (m_sessionPool) QObject::disconnect(m_sessionPool->mountpoints(), &MountpointCatalog::ready, this, nullptr);
 
-    emit errorOccurred(QString("Network error: %1").arg(static_cast<int>(error)));
-    m_state = Idle;
+    // Nothing was created; the retry starts over with connectToJanus()
+    setState(Idle);
+    emit errorOccurred(QString("Failed to list Janus mountpoints: %1").arg(error));
     emit connectionStateChanged(false);
 }
@@ -2,22 +2,19 @@
 #define JANUSCONNECTOR_H
 
 #include <QObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QTimer>
-#include <QWebEngineView>
-#include <QWebChannel>
 #include <QDebug>
 #include <QDateTime>
 #include <QFile>
 #include "cameraparams.h"
-#include <QWebEngineSettings>
-#include <QWebEnginePage>
 #include <QDir>
 #include <QThread>
+#include <QPointer>
 #include "templateloader.h"
+#include "previewprovider.h"
+#include "janussessionpool.h"
 
 class JanusConnector : public QObject
 {
@@ -31,75 +28,115 @@ public:
     void setJanusUrl(const QString &url);
     QString janusUrl() const;
 
+    // Mountpoint requests go through this shared pool of sessions/handles
+    void setSessionPool(JanusSessionPool *pool);
+
+    // On demand: connectToJanus() only reserves a mountpoint ID; the
+    // mountpoint is created by activateMountpoint() and destroyed again by
+    // deactivateMountpoint() when nobody watches
+    void setOnDemand(bool onDemand);
+    void activateMountpoint();
+    void deactivateMountpoint();
+
+    // A restored camera gets the mountpoint ID it had before the restart
+    // back, if the catalog still holds it for this camera
+    void setPreferredMountpointId(int mountpointId) { m_preferredMountpointId = mountpointId; }
+
     // Connect to Janus with camera parameters
     void connectToJanus(const CameraParams &params);
 
+    // Destroys the mountpoint on Janus; disconnect() leaves it in place
+    void removeMountpoint();
+
+    // Applies new names and credentials to the live mountpoint with a Janus
+    // "edit"; the RTSP source must be unchanged. Viewers stay connected.
+    void updateMountpoint(const CameraParams &params);
+
+    // Janus no longer has the mountpoint, e.g. it restarted. Back to Idle
+    // with the ID kept, so connectToJanus() recreates it where pages expect it.
+    void markMountpointLost();
+
     // Disconnect from current session
     void disconnect();
 
     // Current state
     bool isConnected() const;
+    bool isReserved() const { return m_state == Reserved; }
     qint64 sessionId() const;
     qint64 handleId() const;
 
     int mountpointId() const { return m_mountpointId; }
     CameraParams currentParams() const { return m_currentParams; }
 
+    // Unsolicited streaming plugin event for this camera's mountpoint
+    void handlePluginEvent(const QJsonObject &data);
+
+    // Streaming plugin "create" body for an RTSP mountpoint
+    static QJsonObject mountpointCreateRequest(const CameraParams &params, int mountpointId);
+
+    // startStreaming() shows a local preview through this provider.
+    // Without one (headless builds) there is no preview.
+    void setPreviewProvider(PreviewProvider *provider);
+
 public slots:
     void startStreaming();
     void stopStreaming();
 
 signals:
     void sessionReady(qint64 sessionId, qint64 handleId);
+    // On demand: the mountpoint ID is known, the mountpoint not created yet
+    void mountpointReserved();
     void streamingStarted();
     void streamingStopped();
     void errorOccurred(const QString &error);
     void connectionStateChanged(bool connected);
+    void mountpointUpdated();
+    // pluginErrorCode is the streaming plugin's error_code, 0 for other failures
+    void updateFailed(const CameraParams &params, const QString &error, int pluginErrorCode);
 
 private slots:
-    void onSessionCreated();
-    void onPluginAttached();
-    void onMountpointCreated();
-    void onNetworkError(QNetworkReply::NetworkError error);
-    void sendKeepAlive();
+    void onMountpointCreated(const QJsonObject &data, qint64 sessionId, qint64 handleId);
+    void onRequestFailed(const QString &error);
+    void onCatalogFailed(const QString &error);
+    void provisionMountpoint();
 private:
     enum State {
         Idle,
-        CreatingSession,
-        AttachingPlugin,
+        Reserved,
         CreatingMountpoint,
         Ready,
         Streaming
     };
 
-    void createJanusSession();
-    void attachToStreamingPlugin();
+    // All state changes go through here so the per-state gauges stay right
+    void setState(State state);
     void createRTSPMountpoint();
-    void setupWebEngineView();
+    void sendDestroy();
+    void releasePreview();
     void startWebRTCStreaming();
     void cleanup();
 
-    // Network and UI components
-    QNetworkAccessManager *m_networkManager;
-    QWebEngineView *m_webView;
-    QWebChannel *m_webChannel;
-    QTimer *m_keepAliveTimer;
+    // Janus and UI components
+    QPointer<JanusSessionPool> m_sessionPool;
+    QPointer<PreviewProvider> m_previewProvider;
+    bool m_previewing;
 
     // Janus connection state
     QString m_janusUrl;
     qint64 m_sessionId;
     qint64 m_handleId;
     State m_state;
+    bool m_onDemand;
 
     // Current camera parameters
     CameraParams m_currentParams;
 
     // Request tracking
-    QNetworkReply *m_currentReply;
+    QPointer<JanusTransaction> m_currentTransaction;
 
-    // ADDED for unique mountpoint IDs
-    static int s_nextMountpointId;
+    // Adopted or allocated from the pool's MountpointCatalog; 0 until then
     int m_mountpointId;
+    int m_preferredMountpointId;
 };
 
 #endif // JANUSCONNECTOR_H
@@ -0,0 +1,408 @@
+#include "janussessionpool.h"
+#include "logger.h"
+#include <QTimer>
+
+namespace {
+
+// A request, including the event that completes an acknowledged one, is
+// given up on after this long; a lost event would otherwise hold its
+// camera's setup slot for good
+const int RequestTimeoutMs = 10000;
+
+// Reconnect backoff for a channel that was up, e.g. while Janus restarts
+const int ChannelRetryInitialMs = 1000;
+const int ChannelRetryMaxMs = 30000;
+
+QString janusError(const QJsonObject &obj)
+{
+    QJsonObject error = obj["error"].toObject();
+    return QString("Janus error %1: %2").arg(error["code"].toInt()).arg(error["reason"].toString());
+}
+
+} // namespace
+
+JanusSessionPool::JanusSessionPool(const QString &janusUrl, KeepAliveScheduler *keepAliveScheduler,
+                                   int sessionCount, QObject *parent)
+    : QObject(parent)
+    , m_transport(JanusTransport::create(janusUrl, this))
+    , m_mountpoints(new MountpointCatalog(this))
+    , m_keepAliveScheduler(keepAliveScheduler)
+    , m_janusUrl(janusUrl)
+    , m_nextChannel(0)
+    , m_transactionCounter(0)
+{
+    m_channels.resize(qMax(1, sessionCount));
+
+    connect(m_transport, &JanusTransport::eventReceived, this, &JanusSessionPool::onTransportEvent);
+    connect(m_transport, &JanusTransport::sessionEventsFailed, this, &JanusSessionPool::onSessionEventsFailed);
+}
+
+JanusSessionPool::~JanusSessionPool()
+{
+    if (m_keepAliveScheduler) {
+        for (const Channel &channel : std::as_const(m_channels)) {
+            if (channel.sessionId > 0) m_keepAliveScheduler->removeSession(this, channel.sessionId);
+        }
+    }
+
+    for (const PendingRequest &pending : std::as_const(m_queued)) {
+        if (pending.transaction) {
+            emit pending.transaction->failed("Session pool destroyed");
+        }
+    }
+    for (const InFlightRequest &request : std::as_const(m_inFlight)) {
+        if (request.transaction) {
+            emit request.transaction->failed("Session pool destroyed");
+        }
+    }
+}
+
+JanusTransaction *JanusSessionPool::sendStreamingRequest(const QJsonObject &body)
+{
+    JanusTransaction *transaction = new JanusTransaction(nextTransactionId("tx-stream"), this);
+    m_queued.enqueue({ transaction, body });
+    dispatchQueued();
+    return transaction;
+}
+
+void JanusSessionPool::setMaxEventsPerPoll(int maxEvents)
+{
+    m_transport->setMaxEventsPerPoll(maxEvents);
+}
+
+int JanusSessionPool::readySessionCount() const
+{
+    int count = 0;
+    for (const Channel &channel : m_channels) {
+        if (channel.state == Up) count++;
+    }
+    return count;
+}
+
+void JanusSessionPool::establishChannel(int index)
+{
+    m_channels[index].state = Connecting;
+
+    QJsonObject createRequest;
+    createRequest["janus"] = "create";
+    createRequest["transaction"] = nextTransactionId("tx-create-session");
+
+    QElapsedTimer createTimer;
+    createTimer.start();
+    m_transport->send(createRequest, 0, 0, [this, index, createTimer](const QJsonObject &obj, QString error) {
+        if (error.isEmpty() && obj["janus"].toString() != "success") {
+            error = janusError(obj);
+        }
+        Metrics::global().recordJanusRequest(Metrics::StageSessionCreate, createTimer.nsecsElapsed() / 1000,
+                                             error.isEmpty());
+        if (!error.isEmpty()) {
+            onChannelFailed(index, QString("Failed to create Janus session: %1").arg(error));
+            retryChannelLater(index);
+            return;
+        }
+
+        qint64 sessionId = obj["data"].toObject()["id"].toVariant().toLongLong();
+        m_channels[index].sessionId = sessionId;
+        if (m_keepAliveScheduler) m_keepAliveScheduler->addSession(this, sessionId);
+        m_transport->watchSession(sessionId);
+
+        QJsonObject attachRequest;
+        attachRequest["janus"] = "attach";
+        attachRequest["plugin"] = "janus.plugin.streaming";
+        attachRequest["transaction"] = nextTransactionId("tx-attach-plugin");
+
+        QElapsedTimer attachTimer;
+        attachTimer.start();
+        m_transport->send(attachRequest, sessionId, 0, [this, index, sessionId, attachTimer](const QJsonObject &obj, QString error) {
+            // The session was lost (e.g. its event stream failed) while attaching
+            if (m_channels[index].sessionId != sessionId) return;
+
+            if (error.isEmpty() && obj["janus"].toString() != "success") {
+                error = janusError(obj);
+            }
+            Metrics::global().recordJanusRequest(Metrics::StageAttach, attachTimer.nsecsElapsed() / 1000,
+                                                 error.isEmpty());
+            if (!error.isEmpty()) {
+                onChannelFailed(index, QString("Failed to attach to streaming plugin: %1").arg(error));
+                retryChannelLater(index);
+                return;
+            }
+
+            Channel &channel = m_channels[index];
+            const bool reestablished = channel.everUp;
+            channel.handleId = obj["data"].toObject()["id"].toVariant().toLongLong();
+            channel.state = Up;
+            channel.everUp = true;
+            channel.retryMs = 0;
+            LOG_INFO("janus_channel_up").field("channel", index)
+                .field("session", channel.sessionId).field("handle", channel.handleId)
+                .field("reestablished", reestablished);
+
+            if (reestablished) emit sessionReestablished();
+            dispatchQueued();
+        });
+    });
+}
+
+void JanusSessionPool::onChannelFailed(int index, const QString &error)
+{
+    LOG_WARNING("janus_channel_down").field("channel", index).field("error", error);
+
+    Channel &channel = m_channels[index];
+    const qint64 sessionId = channel.sessionId;
+    if (sessionId > 0) {
+        m_transport->unwatchSession(sessionId);
+        if (m_keepAliveScheduler) m_keepAliveScheduler->removeSession(this, sessionId);
+    }
+    channel.state = Down;
+    channel.sessionId = 0;
+    channel.handleId = 0;
+
+    // Requests waiting on this session will never be answered. Collect them
+    // first: failure handlers may send new requests.
+    QList<QPointer<JanusTransaction>> orphaned;
+    for (auto it = m_inFlight.begin(); it != m_inFlight.end();) {
+        if (it->channel == index && it->sessionId == sessionId) {
+            Metrics::global().recordJanusRequest(it->stage, it->timer.nsecsElapsed() / 1000, false);
+            orphaned.append(it->transaction);
+            it = m_inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const QPointer<JanusTransaction> &transaction : std::as_const(orphaned)) {
+        if (transaction) {
+            emit transaction->failed(error);
+            transaction->deleteLater();
+        }
+    }
+
+    // Nothing left that could serve the queue: fail it rather than hang
+    for (const Channel &other : std::as_const(m_channels)) {
+        if (other.state != Down) return;
+    }
+    while (!m_queued.isEmpty()) {
+        PendingRequest pending = m_queued.dequeue();
+        if (pending.transaction) {
+            emit pending.transaction->failed(error);
+            pending.transaction->deleteLater();
+        }
+    }
+}
+
+void JanusSessionPool::retryChannelLater(int index)
+{
+    // A channel that never came up waits for the next request instead.
+    // One that was up keeps trying, or nothing would notice Janus is back
+    // and recheck the mountpoints it lost.
+    Channel &channel = m_channels[index];
+    if (!channel.everUp) return;
+
+    channel.retryMs = channel.retryMs > 0 ? qMin(channel.retryMs * 2, ChannelRetryMaxMs) : ChannelRetryInitialMs;
+    QTimer::singleShot(channel.retryMs, this, [this, index]() {
+        if (m_channels[index].state == Down) establishChannel(index);
+    });
+}
+
+void JanusSessionPool::dispatchQueued()
+{
+    while (!m_queued.isEmpty()) {
+        // Round-robin over the channels that are up
+        int index = -1;
+        for (int i = 0; i < m_channels.size(); i++) {
+            int candidate = (m_nextChannel + i) % m_channels.size();
+            if (m_channels[candidate].state == Up) {
+                index = candidate;
+                break;
+            }
+        }
+
+        if (index == -1) {
+            // Bring every idle channel up; the queue drains once one is ready
+            for (int i = 0; i < m_channels.size(); i++) {
+                if (m_channels[i].state == Down) establishChannel(i);
+            }
+            return;
+        }
+
+        m_nextChannel = (index + 1) % m_channels.size();
+        PendingRequest pending = m_queued.dequeue();
+        if (pending.transaction) {
+            dispatch(index, pending.transaction, pending.body);
+        }
+    }
+}
+
+void JanusSessionPool::dispatch(int index, JanusTransaction *transaction, const QJsonObject &body)
+{
+    const Channel &channel = m_channels[index];
+    const QString transactionId = transaction->id();
+    InFlightRequest &request = m_inFlight[transactionId];
+    request.transaction = transaction;
+    request.channel = index;
+    request.sessionId = channel.sessionId;
+    request.handleId = channel.handleId;
+    request.stage = Metrics::stageFor(body["request"].toString());
+    request.timer.start();
+
+    QJsonObject message;
+    message["janus"] = "message";
+    message["transaction"] = transactionId;
+    message["body"] = body;
+
+    QTimer::singleShot(RequestTimeoutMs, this, [this, transactionId]() {
+        if (m_inFlight.contains(transactionId)) {
+            finishRequest(transactionId, QJsonObject(), "Janus request timed out");
+        }
+    });
+
+    m_transport->send(message, channel.sessionId, channel.handleId,
+                      [this, transactionId](const QJsonObject &obj, const QString &error) {
+        // Already answered by an event, or its session went down
+        if (!m_inFlight.contains(transactionId)) return;
+
+        if (error.isEmpty() && obj["janus"].toString() == "ack") {
+            // Asynchronous request: the result arrives as an event
+            return;
+        }
+        finishRequest(transactionId, obj, error);
+    });
+}
+
+void JanusSessionPool::finishRequest(const QString &transactionId, const QJsonObject &reply, const QString &replyError)
+{
+    const InFlightRequest request = m_inFlight.take(transactionId);
+
+    QString error = replyError;
+    if (error.isEmpty()) {
+        const QString kind = reply["janus"].toString();
+        if (kind == "error") {
+            error = janusError(reply);
+            // 458 no such session, 459 no such handle: this channel is gone
+            int code = reply["error"].toObject()["code"].toInt();
+            if ((code == 458 || code == 459) && m_channels[request.channel].sessionId == request.sessionId) {
+                onChannelFailed(request.channel, error);
+                establishChannel(request.channel);
+            }
+        } else if (reply["transaction"].toString() != transactionId) {
+            error = "Janus reply for unexpected transaction";
+        } else if (kind != "success" && kind != "event") {
+            error = QString("Unexpected Janus reply: %1").arg(kind);
+        }
+    }
+
+    QJsonObject data = reply["plugindata"].toObject()["data"].toObject();
+    int pluginErrorCode = 0;
+    if (error.isEmpty() && data.contains("error_code")) {
+        pluginErrorCode = data["error_code"].toInt();
+        error = QString("Streaming plugin error %1: %2").arg(pluginErrorCode).arg(data["error"].toString());
+    }
+
+    Metrics::global().recordJanusRequest(request.stage, request.timer.nsecsElapsed() / 1000, error.isEmpty());
+
+    if (!request.transaction) return;
+    if (error.isEmpty()) {
+        emit request.transaction->succeeded(data, request.sessionId, request.handleId);
+    } else {
+        request.transaction->setPluginErrorCode(pluginErrorCode);
+        emit request.transaction->failed(error);
+    }
+    request.transaction->deleteLater();
+}
+
+void JanusSessionPool::onTransportEvent(qint64 sessionId, const QJsonObject &event)
+{
+    const int index = channelForSession(sessionId);
+    if (index != -1) handleEvent(index, event);
+}
+
+void JanusSessionPool::onSessionEventsFailed(qint64 sessionId, const QString &error)
+{
+    // A dead event stream means a dead session; notice now rather than on
+    // the next request or keepalive
+    const int index = channelForSession(sessionId);
+    if (index == -1) return;
+
+    onChannelFailed(index, error);
+    establishChannel(index);
+}
+
+void JanusSessionPool::handleEvent(int index, const QJsonObject &event)
+{
+    const QString kind = event["janus"].toString();
+    const qint64 sessionId = m_channels[index].sessionId;
+
+    // Nothing happened during a long-poll window
+    if (kind == "keepalive") return;
+
+    if (kind == "timeout") {
+        onChannelFailed(index, "Janus session timed out");
+        establishChannel(index);
+        return;
+    }
+
+    const qint64 sender = event["sender"].toVariant().toLongLong();
+    if (kind == "detached" && sender == m_channels[index].handleId) {
+        onChannelFailed(index, "Streaming plugin handle detached");
+        establishChannel(index);
+        return;
+    }
+
+    // Result of an acknowledged request
+    const QString transactionId = event["transaction"].toString();
+    if (!transactionId.isEmpty() && m_inFlight.contains(transactionId)) {
+        finishRequest(transactionId, event, QString());
+        return;
+    }
+
+    if (kind == "event") {
+        emit pluginEvent(sessionId, sender, event["plugindata"].toObject()["data"].toObject());
+        return;
+    }
+
+    LOG_DEBUG("janus_event").field("kind", kind).field("session", sessionId);
+}
+
+int JanusSessionPool::channelForSession(qint64 sessionId) const
+{
+    if (sessionId <= 0) return -1;
+    for (int i = 0; i < m_channels.size(); i++) {
+        if (m_channels[i].sessionId == sessionId) return i;
+    }
+    return -1;
+}
+
+bool JanusSessionPool::sendKeepAlive(qint64 sessionId)
+{
+    const int index = channelForSession(sessionId);
+    if (index == -1) return false;
+
+    QJsonObject keepAlive;
+    keepAlive["janus"] = "keepalive";
+    keepAlive["session_id"] = sessionId;
+    keepAlive["transaction"] = nextTransactionId("tx-keepalive");
+
+    QElapsedTimer timer;
+    timer.start();
+    m_transport->send(keepAlive, sessionId, 0, [this, index, sessionId, timer](const QJsonObject &obj, QString error) {
+        if (error.isEmpty() && obj["janus"].toString() != "ack") {
+            error = janusError(obj);
+        }
+        Metrics::global().recordJanusRequest(Metrics::StageKeepAlive, timer.nsecsElapsed() / 1000, error.isEmpty());
+        if (error.isEmpty()) return;
+
+        if (m_keepAliveScheduler) m_keepAliveScheduler->recordFailure();
+
+        // A lost session is re-established right away so requests keep flowing
+        if (m_channels[index].sessionId == sessionId) {
+            onChannelFailed(index, QString("Keepalive failed: %1").arg(error));
+            establishChannel(index);
+        }
+    });
+    return true;
+}
+
+QString JanusSessionPool::nextTransactionId(const char *prefix)
+{
+    return QString("%1-%2").arg(QLatin1String(prefix)).arg(++m_transactionCounter);
+}
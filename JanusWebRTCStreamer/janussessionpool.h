@@ -0,0 +1,139 @@
+#ifndef JANUSSESSIONPOOL_H
+#define JANUSSESSIONPOOL_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QPointer>
+#include <QQueue>
+#include <QHash>
+#include <QDebug>
+#include <QElapsedTimer>
+#include "keepalivescheduler.h"
+#include "janustransport.h"
+#include "mountpointcatalog.h"
+#include "metrics.h"
+
+// One streaming plugin request sent through a JanusSessionPool
+class JanusTransaction : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JanusTransaction(const QString &id, QObject *parent = nullptr)
+        : QObject(parent), m_id(id) {}
+
+    QString id() const { return m_id; }
+
+    // The streaming plugin's error_code once failed() was emitted for a
+    // plugin error, e.g. 455 no such mountpoint; 0 for any other failure
+    int pluginErrorCode() const { return m_pluginErrorCode; }
+    void setPluginErrorCode(int code) { m_pluginErrorCode = code; }
+
+signals:
+    // data is the plugin's reply, e.g. {"streaming":"created", ...}
+    void succeeded(const QJsonObject &data, qint64 sessionId, qint64 handleId);
+    void failed(const QString &error);
+
+private:
+    QString m_id;
+    int m_pluginErrorCode = 0;
+};
+
+// Keeps a few Janus sessions, each with one janus.plugin.streaming handle,
+// and multiplexes mountpoint requests from every camera over them. Requests
+// carry unique transaction IDs, so a camera's setup is a single round trip
+// once the pool is up instead of create session -> attach -> create.
+// Janus is reached over HTTP or, for ws:// URLs, one WebSocket (see
+// JanusTransport). Events pushed for a session complete acknowledged ("ack")
+// requests and report session timeouts and unsolicited plugin events as
+// soon as Janus sends them.
+class JanusSessionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit JanusSessionPool(const QString &janusUrl, KeepAliveScheduler *keepAliveScheduler,
+                              int sessionCount = 2, QObject *parent = nullptr);
+    ~JanusSessionPool();
+
+    QString janusUrl() const { return m_janusUrl; }
+
+    // Sends a streaming plugin request ("create", "edit", "destroy", ...).
+    // Requests made before a session is up are queued. The transaction is
+    // parented to the pool and deletes itself after it has finished.
+    JanusTransaction *sendStreamingRequest(const QJsonObject &body);
+
+    int readySessionCount() const;
+
+    // Mountpoints on this Janus node and the ID allocator for them
+    MountpointCatalog *mountpoints() const { return m_mountpoints; }
+
+    // Events fetched per long-poll round trip (HTTP transport only)
+    void setMaxEventsPerPoll(int maxEvents);
+
+    // Called by the KeepAliveScheduler. Returns false if the session no
+    // longer belongs to this pool; a failed keepalive re-establishes it.
+    bool sendKeepAlive(qint64 sessionId);
+
+signals:
+    // Plugin event that did not answer a request of ours, e.g. a mountpoint
+    // status change. data is the plugin payload.
+    void pluginEvent(qint64 sessionId, qint64 handleId, const QJsonObject &data);
+    // A channel that had been up came back on a new session. If Janus
+    // restarted, every mountpoint on it is gone.
+    void sessionReestablished();
+
+private:
+    enum ChannelState {
+        Down,
+        Connecting,
+        Up
+    };
+
+    struct Channel {
+        ChannelState state = Down;
+        qint64 sessionId = 0;
+        qint64 handleId = 0;
+        bool everUp = false;
+        int retryMs = 0;        // backoff while a channel that was up can't come back
+    };
+
+    struct PendingRequest {
+        QPointer<JanusTransaction> transaction;
+        QJsonObject body;
+    };
+
+    // A dispatched request; stays here until its reply or event arrives
+    struct InFlightRequest {
+        QPointer<JanusTransaction> transaction;
+        int channel = -1;
+        qint64 sessionId = 0;
+        qint64 handleId = 0;
+        Metrics::JanusStage stage = Metrics::StageOther;
+        QElapsedTimer timer;
+    };
+
+    void establishChannel(int index);
+    void onChannelFailed(int index, const QString &error);
+    void retryChannelLater(int index);
+    void dispatchQueued();
+    void dispatch(int index, JanusTransaction *transaction, const QJsonObject &body);
+    void finishRequest(const QString &transactionId, const QJsonObject &reply, const QString &error);
+    void onTransportEvent(qint64 sessionId, const QJsonObject &event);
+    void onSessionEventsFailed(qint64 sessionId, const QString &error);
+    void handleEvent(int index, const QJsonObject &event);
+    int channelForSession(qint64 sessionId) const;
+    QString nextTransactionId(const char *prefix);
+
+    JanusTransport *m_transport;
+    MountpointCatalog *m_mountpoints;
+    QPointer<KeepAliveScheduler> m_keepAliveScheduler;
+    QString m_janusUrl;
+    QList<Channel> m_channels;
+    QQueue<PendingRequest> m_queued;
+    QHash<QString, InFlightRequest> m_inFlight;
+    int m_nextChannel;
+    quint64 m_transactionCounter;
+};
+
+#endif // JANUSSESSIONPOOL_H
@@ -0,0 +1,270 @@
+#include "janustransport.h"
+#include "logger.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QDateTime>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QDebug>
+
+namespace {
+
+const int RequestTimeoutMs = 10000;
+
+// Janus holds an idle poll open for 30 seconds before answering
+const int PollTimeoutMs = 45000;
+
+QJsonDocument parseJson(const QByteArray &data, QString *error)
+{
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (parseError.error != QJsonParseError::NoError || doc.isNull()) {
+        *error = "Failed to parse Janus response";
+    }
+    return doc;
+}
+
+} // namespace
+
+JanusTransport *JanusTransport::create(const QString &janusUrl, QObject *parent)
+{
+    if (janusUrl.startsWith("ws://") || janusUrl.startsWith("wss://")) {
+        return new WebSocketJanusTransport(janusUrl, parent);
+    }
+    return new HttpJanusTransport(janusUrl, parent);
+}
+
+HttpJanusTransport::HttpJanusTransport(const QString &janusUrl, QObject *parent)
+    : JanusTransport(janusUrl, parent)
+    , m_networkManager(new QNetworkAccessManager(this))
+    , m_maxEventsPerPoll(10)
+{
+    m_networkManager->setTransferTimeout(RequestTimeoutMs);
+}
+
+void HttpJanusTransport::send(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+                              const ReplyHandler &handler)
+{
+    QString url = m_janusUrl;
+    if (sessionId > 0) url += QString("/%1").arg(sessionId);
+    if (handleId > 0) url += QString("/%1").arg(handleId);
+
+    QNetworkRequest request((QUrl(url)));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    QNetworkReply *reply = m_networkManager->post(request, QJsonDocument(message).toJson(QJsonDocument::Compact));
+    connect(reply, &QNetworkReply::finished, this, [reply, handler]() {
+        reply->deleteLater();
+
+        if (reply->error() != QNetworkReply::NoError) {
+            handler(QJsonObject(), QString("Network error: %1").arg(reply->errorString()));
+            return;
+        }
+
+        QString error;
+        QJsonDocument doc = parseJson(reply->readAll(), &error);
+        if (error.isEmpty() && !doc.isObject()) error = "Failed to parse Janus response";
+        handler(error.isEmpty() ? doc.object() : QJsonObject(), error);
+    });
+}
+
+void HttpJanusTransport::watchSession(qint64 sessionId)
+{
+    if (m_polls.contains(sessionId)) return;
+    m_polls.insert(sessionId, nullptr);
+    poll(sessionId);
+}
+
+void HttpJanusTransport::unwatchSession(qint64 sessionId)
+{
+    QPointer<QNetworkReply> reply = m_polls.take(sessionId);
+    if (!reply) return;
+
+    QObject::disconnect(reply, nullptr, this, nullptr);
+    reply->abort();
+    reply->deleteLater();
+}
+
+void HttpJanusTransport::poll(qint64 sessionId)
+{
+    QUrl url(QString("%1/%2").arg(m_janusUrl).arg(sessionId));
+    QUrlQuery query;
+    query.addQueryItem("maxev", QString::number(m_maxEventsPerPoll));
+    query.addQueryItem("rid", QString::number(QDateTime::currentMSecsSinceEpoch()));
+    url.setQuery(query);
+
+    QNetworkRequest request(url);
+    request.setTransferTimeout(PollTimeoutMs);
+
+    QNetworkReply *reply = m_networkManager->get(request);
+    m_polls[sessionId] = reply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, sessionId]() {
+        reply->deleteLater();
+        if (m_polls.value(sessionId) != reply) return;
+
+        QString error;
+        QJsonDocument doc;
+        if (reply->error() != QNetworkReply::NoError) {
+            error = QString("Network error: %1").arg(reply->errorString());
+        } else {
+            doc = parseJson(reply->readAll(), &error);
+        }
+
+        if (!error.isEmpty()) {
+            m_polls.remove(sessionId);
+            emit sessionEventsFailed(sessionId, QString("Event poll failed: %1").arg(error));
+            return;
+        }
+
+        // maxev > 1 answers with an array, otherwise a single event
+        const QJsonArray events = doc.isArray() ? doc.array() : QJsonArray{ doc.object() };
+        for (const QJsonValue &event : events) {
+            emit eventReceived(sessionId, event.toObject());
+            // A handler may have dropped the session
+            if (m_polls.value(sessionId) != reply) return;
+        }
+
+        poll(sessionId);
+    });
+}
+
+WebSocketJanusTransport::WebSocketJanusTransport(const QString &janusUrl, QObject *parent)
+    : JanusTransport(janusUrl, parent)
+    , m_socket(new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this))
+{
+    connect(m_socket, &QWebSocket::connected, this, &WebSocketJanusTransport::onConnected);
+    connect(m_socket, &QWebSocket::disconnected, this, &WebSocketJanusTransport::onDisconnected);
+    connect(m_socket, &QWebSocket::textMessageReceived,
+            this, &WebSocketJanusTransport::onTextMessageReceived);
+    // Queued so the socket's state has settled: a failed connect ends in
+    // UnconnectedState without ever emitting disconnected()
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    connect(m_socket, &QWebSocket::errorOccurred, this, &WebSocketJanusTransport::onError, Qt::QueuedConnection);
+#else
+    connect(m_socket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error),
+            this, &WebSocketJanusTransport::onError, Qt::QueuedConnection);
+#endif
+}
+
+WebSocketJanusTransport::~WebSocketJanusTransport()
+{
+    // The owner is going away; nobody is left to answer
+    m_pending.clear();
+    QObject::disconnect(m_socket, nullptr, this, nullptr);
+}
+
+void WebSocketJanusTransport::send(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+                                   const ReplyHandler &handler)
+{
+    // Over WebSocket the target travels in the message instead of the URL
+    QJsonObject addressed = message;
+    if (sessionId > 0) addressed["session_id"] = sessionId;
+    if (handleId > 0) addressed["handle_id"] = handleId;
+
+    const QString transaction = addressed["transaction"].toString();
+    m_pending.insert(transaction, handler);
+
+    QTimer::singleShot(RequestTimeoutMs, this, [this, transaction]() {
+        // Never send a request its caller has given up on: a late session
+        // create would leave an orphaned session behind
+        m_outbox.removeIf([&transaction](const Outgoing &outgoing) {
+            return outgoing.transaction == transaction;
+        });
+        ReplyHandler handler = m_pending.take(transaction);
+        if (handler) handler(QJsonObject(), "Janus request timed out");
+    });
+
+    const QByteArray payload = QJsonDocument(addressed).toJson(QJsonDocument::Compact);
+    if (m_socket->state() == QAbstractSocket::ConnectedState) {
+        m_socket->sendTextMessage(QString::fromUtf8(payload));
+    } else {
+        m_outbox.append({ transaction, payload });
+        open();
+    }
+}
+
+void WebSocketJanusTransport::open()
+{
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) return;
+
+    QNetworkRequest request((QUrl(m_janusUrl)));
+    request.setRawHeader("Sec-WebSocket-Protocol", "janus-protocol");
+    m_socket->open(request);
+}
+
+void WebSocketJanusTransport::onConnected()
+{
+    LOG_INFO("janus_websocket_connected").field("url", m_janusUrl);
+
+    const QList<Outgoing> outbox = std::exchange(m_outbox, {});
+    for (const Outgoing &outgoing : outbox) {
+        m_socket->sendTextMessage(QString::fromUtf8(outgoing.payload));
+    }
+}
+
+void WebSocketJanusTransport::onDisconnected()
+{
+    const QString error = QString("Janus WebSocket closed: %1").arg(m_socket->errorString());
+    LOG_WARNING("janus_websocket_closed").field("url", m_janusUrl).field("error", m_socket->errorString());
+
+    m_outbox.clear();
+    failPending(error);
+
+    // Janus tears down sessions created over a socket when it closes
+    const QSet<qint64> watched = std::exchange(m_watched, {});
+    for (qint64 sessionId : watched) {
+        emit sessionEventsFailed(sessionId, error);
+    }
+}
+
+void WebSocketJanusTransport::onError(QAbstractSocket::SocketError error)
+{
+    // A dropped connection is handled by onDisconnected(); here only a
+    // connect that failed, or one already being retried, is left
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) return;
+
+    LOG_RATE_LIMITED(LogLevel::Warning, 10, "janus_websocket_connect_failed")
+        .field("url", m_janusUrl).field("code", int(error)).field("error", m_socket->errorString());
+
+    // Nothing was sent, so nothing is waiting on Janus either
+    m_outbox.clear();
+    failPending(QString("Janus WebSocket connect failed: %1").arg(m_socket->errorString()));
+}
+
+void WebSocketJanusTransport::onTextMessageReceived(const QString &message)
+{
+    QString error;
+    QJsonDocument doc = parseJson(message.toUtf8(), &error);
+    if (!error.isEmpty() || !doc.isObject()) {
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "janus_message_malformed");
+        return;
+    }
+
+    const QJsonObject obj = doc.object();
+    const QString kind = obj["janus"].toString();
+
+    // Direct replies complete their request; an async request's later
+    // "event" shares the transaction but arrives after the ack
+    if (kind == "success" || kind == "error" || kind == "ack") {
+        ReplyHandler handler = m_pending.take(obj["transaction"].toString());
+        if (handler) {
+            handler(obj, QString());
+            return;
+        }
+    }
+
+    const qint64 sessionId = obj["session_id"].toVariant().toLongLong();
+    if (m_watched.contains(sessionId)) {
+        emit eventReceived(sessionId, obj);
+    }
+}
+
+void WebSocketJanusTransport::failPending(const QString &error)
+{
+    const QHash<QString, ReplyHandler> pending = std::exchange(m_pending, {});
+    for (const ReplyHandler &handler : pending) {
+        handler(QJsonObject(), error);
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef JANUSTRANSPORT_H
+#define JANUSTRANSPORT_H
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QPointer>
+#include <QSet>
+#include <QWebSocket>
+#include <functional>
+#include <utility>
+
+// How JanusSessionPool talks to one Janus node. A transport sends Janus
+// messages and hands back the synchronous reply (success, ack or error),
+// and delivers everything Janus pushes for a session as eventReceived().
+class JanusTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    // reply is empty when error is set
+    using ReplyHandler = std::function<void(const QJsonObject &reply, const QString &error)>;
+
+    explicit JanusTransport(const QString &janusUrl, QObject *parent = nullptr)
+        : QObject(parent), m_janusUrl(janusUrl) {}
+
+    // ws:// and wss:// URLs get a WebSocket transport, anything else HTTP
+    static JanusTransport *create(const QString &janusUrl, QObject *parent = nullptr);
+
+    QString janusUrl() const { return m_janusUrl; }
+
+    // message must carry a transaction. sessionId/handleId address it;
+    // 0 means the server (create) or the session (attach, keepalive).
+    virtual void send(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+                      const ReplyHandler &handler) = 0;
+
+    // Start/stop delivering a session's events
+    virtual void watchSession(qint64 sessionId) = 0;
+    virtual void unwatchSession(qint64 sessionId) = 0;
+
+    // Only meaningful for transports that poll for events
+    virtual void setMaxEventsPerPoll(int maxEvents) { Q_UNUSED(maxEvents) }
+
+signals:
+    void eventReceived(qint64 sessionId, const QJsonObject &event);
+    // The session's event stream broke; the session should be considered lost
+    void sessionEventsFailed(qint64 sessionId, const QString &error);
+
+protected:
+    QString m_janusUrl;
+};
+
+// One POST per message; events come from a GET <url>/<session>?maxev=N
+// long-poll per watched session.
+class HttpJanusTransport : public JanusTransport
+{
+    Q_OBJECT
+
+public:
+    explicit HttpJanusTransport(const QString &janusUrl, QObject *parent = nullptr);
+
+    void send(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+              const ReplyHandler &handler) override;
+    void watchSession(qint64 sessionId) override;
+    void unwatchSession(qint64 sessionId) override;
+    void setMaxEventsPerPoll(int maxEvents) override { m_maxEventsPerPoll = qMax(1, maxEvents); }
+
+private:
+    void poll(qint64 sessionId);
+
+    QNetworkAccessManager *m_networkManager;
+    QHash<qint64, QPointer<QNetworkReply>> m_polls;
+    int m_maxEventsPerPoll;
+};
+
+// Every message over one persistent WebSocket ("janus-protocol"); replies
+// are matched by transaction and events are pushed. The socket is opened on
+// first use and again after it drops.
+class WebSocketJanusTransport : public JanusTransport
+{
+    Q_OBJECT
+
+public:
+    explicit WebSocketJanusTransport(const QString &janusUrl, QObject *parent = nullptr);
+    ~WebSocketJanusTransport();
+
+    void send(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+              const ReplyHandler &handler) override;
+    void watchSession(qint64 sessionId) override { m_watched.insert(sessionId); }
+    void unwatchSession(qint64 sessionId) override { m_watched.remove(sessionId); }
+
+private slots:
+    void onConnected();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError error);
+    void onTextMessageReceived(const QString &message);
+
+private:
+    void open();
+    void failPending(const QString &error);
+
+    struct Outgoing {
+        QString transaction;
+        QByteArray payload;
+    };
+
+    QWebSocket *m_socket;
+    QList<Outgoing> m_outbox;       // written once the socket is up
+    QHash<QString, ReplyHandler> m_pending;
+    QSet<qint64> m_watched;
+};
+
+#endif // JANUSTRANSPORT_H
@@ -0,0 +1,93 @@
+#include "keepalivescheduler.h"
+#include "janussessionpool.h"
+#include "metrics.h"
+#include "logger.h"
+
+KeepAliveScheduler::KeepAliveScheduler(int intervalMs, int slotCount, QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_slotIntervalMs(qMax(1, intervalMs / qMax(1, slotCount)))
+    , m_currentSlot(0)
+    , m_nextTickAt(0)
+{
+    m_wheel.resize(qMax(1, slotCount));
+
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_timer->setInterval(m_slotIntervalMs);
+    connect(m_timer, &QTimer::timeout, this, &KeepAliveScheduler::onTick);
+}
+
+void KeepAliveScheduler::addSession(JanusSessionPool *pool, qint64 sessionId)
+{
+    SessionKey key(pool, sessionId);
+    if (m_slotOf.contains(key)) return;
+
+    // Emptiest slot, searching from the one furthest from now so a new
+    // session is not pinged right after it was created
+    int best = -1;
+    for (int i = 0; i < m_wheel.size(); i++) {
+        int slot = (m_currentSlot + m_wheel.size() - 1 - i) % m_wheel.size();
+        if (best == -1 || m_wheel[slot].size() < m_wheel[best].size()) {
+            best = slot;
+        }
+    }
+
+    m_wheel[best].append({ key, pool });
+    m_slotOf.insert(key, best);
+
+    if (!m_timer->isActive()) {
+        m_clock.start();
+        m_nextTickAt = m_slotIntervalMs;
+        m_timer->start();
+    }
+}
+
+void KeepAliveScheduler::removeSession(const JanusSessionPool *pool, qint64 sessionId)
+{
+    const SessionKey key(pool, sessionId);
+    auto it = m_slotOf.find(key);
+    if (it == m_slotOf.end()) return;
+
+    m_wheel[it.value()].removeIf([&key](const Entry &entry) { return entry.key == key; });
+    m_slotOf.erase(it);
+
+    if (m_slotOf.isEmpty()) {
+        m_timer->stop();
+    }
+}
+
+void KeepAliveScheduler::onTick()
+{
+    const qint64 now = m_clock.elapsed();
+    const qint64 lateBy = now - m_nextTickAt;
+    const bool late = lateBy > m_slotIntervalMs / 2;
+    m_nextTickAt += m_slotIntervalMs;
+    if (now > m_nextTickAt + m_slotIntervalMs) {
+        // Fell far behind (event loop stall); resync instead of bursting
+        m_nextTickAt = now + m_slotIntervalMs;
+    }
+
+    m_currentSlot = (m_currentSlot + 1) % m_wheel.size();
+
+    // Copy: sending may fail synchronously and remove entries
+    const QList<Entry> due = m_wheel[m_currentSlot];
+    for (const Entry &entry : due) {
+        if (!entry.pool || !entry.pool->sendKeepAlive(entry.key.second)) {
+            removeSession(entry.key.first, entry.key.second);
+            continue;
+        }
+
+        Metrics::global().keepAlivesSent.add();
+        if (late) Metrics::global().keepAlivesLate.add();
+    }
+
+    if (late) {
+        LOG_RATE_LIMITED(LogLevel::Warning, 10, "keepalive_tick_late")
+            .field("late_ms", lateBy).field("delayed", due.size());
+    }
+}
+
+void KeepAliveScheduler::recordFailure()
+{
+    Metrics::global().keepAlivesFailed.add();
+}
@@ -0,0 +1,53 @@
+#ifndef KEEPALIVESCHEDULER_H
+#define KEEPALIVESCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class JanusSessionPool;
+
+// Single timer wheel that drives the keepalives of every live Janus session.
+// The interval is split into slots and each session sits in one slot, placed
+// in the emptiest one, so keepalives are spread evenly over the interval and
+// each session gets exactly one per round however often it is registered.
+class KeepAliveScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KeepAliveScheduler(int intervalMs = 30000, int slotCount = 30, QObject *parent = nullptr);
+
+    void addSession(JanusSessionPool *pool, qint64 sessionId);
+    void removeSession(const JanusSessionPool *pool, qint64 sessionId);
+    int sessionCount() const { return m_slotOf.size(); }
+
+    // Called by the pool when a keepalive came back as an error; the pool
+    // re-establishes the session itself. Sent, failed and late keepalives
+    // are counted in Metrics.
+    void recordFailure();
+
+private slots:
+    void onTick();
+
+private:
+    using SessionKey = QPair<const JanusSessionPool*, qint64>;
+    struct Entry {
+        SessionKey key;
+        QPointer<JanusSessionPool> pool;
+    };
+
+    QTimer *m_timer;
+    int m_slotIntervalMs;
+    QList<QList<Entry>> m_wheel;
+    QHash<SessionKey, int> m_slotOf;
+    int m_currentSlot;
+    QElapsedTimer m_clock;
+    qint64 m_nextTickAt;
+};
+
+#endif // KEEPALIVESCHEDULER_H
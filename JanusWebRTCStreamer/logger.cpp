@@ -0,0 +1,384 @@
+#include "logger.h"
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+// How long the sink sleeps when a wakeup was missed
+const unsigned long SinkIdleWaitMs = 100;
+const qsizetype SinkBatchBytes = 64 * 1024;
+
+const char *const LevelNames[] = { "debug", "info", "warning", "error" };
+
+QtMessageHandler s_previousHandler = nullptr;
+
+void appendJsonString(QByteArray &out, const QByteArray &utf8)
+{
+    out += '"';
+    for (char c : utf8) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (uchar(c) < 0x20) {
+                out += "\\u00";
+                out += "0123456789abcdef"[uchar(c) >> 4];
+                out += "0123456789abcdef"[uchar(c) & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+QJsonValue redactJson(const QJsonValue &value)
+{
+    if (value.isObject()) {
+        QJsonObject object = value.toObject();
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            it.value() = Logger::isSensitiveKey(it.key()) ? QJsonValue("***") : redactJson(it.value());
+        }
+        return object;
+    }
+    if (value.isArray()) {
+        QJsonArray array = value.toArray();
+        for (auto it = array.begin(); it != array.end(); ++it) {
+            *it = redactJson(*it);
+        }
+        return array;
+    }
+    if (value.isString()) {
+        return Logger::redact(value.toString());
+    }
+    return value;
+}
+
+void qtMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context)
+
+    LogLevel level = LogLevel::Debug;
+    switch (type) {
+    case QtDebugMsg:    level = LogLevel::Debug; break;
+    case QtInfoMsg:     level = LogLevel::Info; break;
+    case QtWarningMsg:  level = LogLevel::Warning; break;
+    case QtCriticalMsg:
+    case QtFatalMsg:    level = LogLevel::Error; break;
+    }
+
+    if (type == QtFatalMsg) {
+        // The process is about to abort; don't leave this in the ring
+        Logger::global().stop();
+        LogRecord(level, "fatal").field("msg", message);
+        std::abort();
+    }
+
+    if (!Logger::global().isEnabled(level)) return;
+    LogRecord(level, "qt").field("msg", message);
+}
+
+} // namespace
+
+LogRateLimiter::LogRateLimiter(int perSecond)
+    : m_perSecond(qMax(1, perSecond))
+    , m_window(-1)
+    , m_count(0)
+    , m_suppressed(0)
+{
+}
+
+bool LogRateLimiter::allow()
+{
+    using namespace std::chrono;
+    const qint64 second = duration_cast<seconds>(steady_clock::now().time_since_epoch()).count();
+
+    qint64 window = m_window.load(std::memory_order_relaxed);
+    if (window != second && m_window.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        m_count.store(0, std::memory_order_relaxed);
+    }
+
+    if (m_count.fetch_add(1, std::memory_order_relaxed) < m_perSecond) return true;
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+LogRecord::LogRecord(LogLevel level, const char *event)
+    : m_level(level)
+{
+    m_line.reserve(256);
+    m_line += "{\"ts\":";
+    m_line += QByteArray::number(QDateTime::currentMSecsSinceEpoch());
+    m_line += ",\"level\":\"";
+    m_line += LevelNames[int(level)];
+    m_line += "\",\"event\":";
+    appendJsonString(m_line, event);
+}
+
+LogRecord::~LogRecord()
+{
+    m_line += '}';
+    Logger::global().submit(m_level, std::move(m_line));
+}
+
+LogRecord &LogRecord::field(const char *key, const QString &value)
+{
+    appendKey(key);
+    if (Logger::isSensitiveKey(QLatin1String(key))) {
+        m_line += "\"***\"";
+    } else {
+        appendJsonString(m_line, Logger::redact(value).toUtf8());
+    }
+    return *this;
+}
+
+LogRecord &LogRecord::field(const char *key, const QByteArray &value)
+{
+    return field(key, QString::fromUtf8(value));
+}
+
+LogRecord &LogRecord::field(const char *key, const char *value)
+{
+    return field(key, QString::fromUtf8(value));
+}
+
+LogRecord &LogRecord::field(const char *key, bool value)
+{
+    appendKey(key);
+    m_line += value ? "true" : "false";
+    return *this;
+}
+
+LogRecord &LogRecord::field(const char *key, const QJsonObject &value)
+{
+    appendKey(key);
+    m_line += QJsonDocument(redactJson(value).toObject()).toJson(QJsonDocument::Compact);
+    return *this;
+}
+
+LogRecord &LogRecord::suppressed(quint64 count)
+{
+    if (count > 0) field("suppressed", count);
+    return *this;
+}
+
+void LogRecord::appendKey(const char *key)
+{
+    m_line += ',';
+    appendJsonString(m_line, key);
+    m_line += ':';
+}
+
+Logger &Logger::global()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : m_slots(new Slot[Capacity])
+    , m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_level(int(LogLevel::Info))
+    , m_running(false)
+    , m_sinkSleeping(false)
+    , m_dropped(0)
+    , m_sinkThread(nullptr)
+{
+    for (size_t i = 0; i < Capacity; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+Logger::~Logger()
+{
+    stop();
+}
+
+void Logger::start()
+{
+    if (m_sinkThread) return;
+
+    m_running.store(true, std::memory_order_release);
+    m_sinkThread = QThread::create([this] { runSink(); });
+    m_sinkThread->setObjectName("LogSink");
+    m_sinkThread->start(QThread::LowPriority);
+
+    s_previousHandler = qInstallMessageHandler(qtMessageHandler);
+}
+
+void Logger::stop()
+{
+    if (!m_sinkThread) return;
+
+    qInstallMessageHandler(s_previousHandler);
+    m_running.store(false, std::memory_order_release);
+    {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wake.wakeOne();
+    }
+    m_sinkThread->wait();
+    delete m_sinkThread;
+    m_sinkThread = nullptr;
+}
+
+LogLevel Logger::levelFromString(const QByteArray &name, LogLevel fallback)
+{
+    const QByteArray lower = name.trimmed().toLower();
+    for (int i = 0; i < 4; i++) {
+        if (lower == LevelNames[i]) return LogLevel(i);
+    }
+    return fallback;
+}
+
+void Logger::submit(LogLevel level, QByteArray &&line)
+{
+    Q_UNUSED(level)
+
+    // Before start() and after stop() there is no sink; write directly
+    if (!m_running.load(std::memory_order_acquire)) {
+        write(line + '\n');
+        return;
+    }
+
+    if (!tryPush(std::move(line))) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (m_sinkSleeping.load(std::memory_order_acquire)) {
+        QMutexLocker locker(&m_wakeMutex);
+        m_wake.wakeOne();
+    }
+}
+
+QString Logger::redact(const QString &text)
+{
+    // Cheap screen first; almost every message has nothing to mask
+    const bool maybeUrl = text.contains(QLatin1String("://")) && text.contains(QLatin1Char('@'));
+    const bool maybeAuth = text.contains(QLatin1String("uthorization"), Qt::CaseInsensitive);
+    const bool maybePassword = text.contains(QLatin1String("pwd"), Qt::CaseInsensitive)
+                               || text.contains(QLatin1String("password"), Qt::CaseInsensitive);
+    if (!maybeUrl && !maybeAuth && !maybePassword) return text;
+
+    static const QRegularExpression urlCredentials(
+        QStringLiteral("([a-z][a-z0-9+.-]*://[^/\\s:@]*:)[^@\\s/]*@"), QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression authorization(
+        QStringLiteral("(authorization\"?\\s*[:=]\\s*\"?(?:basic\\s+|bearer\\s+)?)[^\\s\",}]+"),
+        QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression passwordField(
+        QStringLiteral("(\"[a-z_]*(?:password|pwd)\"\\s*:\\s*\")[^\"]*\""), QRegularExpression::CaseInsensitiveOption);
+
+    QString result = text;
+    if (maybeUrl) result.replace(urlCredentials, QStringLiteral("\\1***@"));
+    if (maybeAuth) result.replace(authorization, QStringLiteral("\\1***"));
+    if (maybePassword) result.replace(passwordField, QStringLiteral("\\1***\""));
+    return result;
+}
+
+bool Logger::isSensitiveKey(const QString &key)
+{
+    return key.contains(QLatin1String("password"), Qt::CaseInsensitive)
+        || key.contains(QLatin1String("pwd"), Qt::CaseInsensitive)
+        || key.compare(QLatin1String("authorization"), Qt::CaseInsensitive) == 0;
+}
+
+// Bounded MPMC queue after Dmitry Vyukov: each slot's sequence number says
+// whether it is free for the producer at that position or filled for the
+// consumer, so producers only contend on one compare-and-swap
+bool Logger::tryPush(QByteArray &&line)
+{
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &m_slots[pos & (Capacity - 1)];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const qptrdiff diff = qptrdiff(sequence) - qptrdiff(pos);
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;   // full
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->line = std::move(line);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool Logger::tryPop(QByteArray *line)
+{
+    // Single consumer: only the sink thread pops
+    const size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    Slot &slot = m_slots[pos & (Capacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+
+    *line = std::move(slot.line);
+    slot.line = QByteArray();
+    slot.sequence.store(pos + Capacity, std::memory_order_release);
+    m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void Logger::runSink()
+{
+    QByteArray batch;
+    QByteArray line;
+    quint64 reportedDrops = 0;
+
+    for (;;) {
+        while (tryPop(&line)) {
+            batch += line;
+            batch += '\n';
+            if (batch.size() >= SinkBatchBytes) {
+                write(batch);
+                batch.clear();
+            }
+        }
+
+        const quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != reportedDrops) {
+            batch += "{\"ts\":" + QByteArray::number(QDateTime::currentMSecsSinceEpoch())
+                   + ",\"level\":\"warning\",\"event\":\"log_dropped\",\"count\":"
+                   + QByteArray::number(dropped - reportedDrops) + "}\n";
+            reportedDrops = dropped;
+        }
+        if (!batch.isEmpty()) {
+            write(batch);
+            batch.clear();
+        }
+
+        if (!m_running.load(std::memory_order_acquire)) {
+            // Producers that raced with stop() may still have pushed
+            while (tryPop(&line)) write(line + '\n');
+            return;
+        }
+
+        // Producers only wake us when this flag is set; re-check after
+        // setting it so a record pushed in between is not left waiting
+        m_sinkSleeping.store(true, std::memory_order_seq_cst);
+        const size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        if (m_slots[pos & (Capacity - 1)].sequence.load(std::memory_order_acquire) != pos + 1
+            && m_running.load(std::memory_order_acquire)) {
+            QMutexLocker locker(&m_wakeMutex);
+            m_wake.wait(&m_wakeMutex, SinkIdleWaitMs);
+        }
+        m_sinkSleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void Logger::write(const QByteArray &data)
+{
+    std::fwrite(data.constData(), 1, size_t(data.size()), stderr);
+    std::fflush(stderr);
+}
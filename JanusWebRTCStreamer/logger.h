@@ -0,0 +1,157 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+// Records below this level are compiled out (0 debug, 1 info, 2 warning,
+// 3 error). Set through the CAMSTREAM_LOG_MIN_LEVEL CMake cache variable.
+#ifndef CAMSTREAM_LOG_MIN_LEVEL
+#define CAMSTREAM_LOG_MIN_LEVEL 0
+#endif
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+// Lets one call site through at most perSecond times a second. The first
+// record let through afterwards reports how many were suppressed.
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(int perSecond);
+
+    bool allow();
+    quint64 takeSuppressed() { return m_suppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    const int m_perSecond;
+    std::atomic<qint64> m_window;
+    std::atomic<int> m_count;
+    std::atomic<quint64> m_suppressed;
+};
+
+// One structured log line, written as a JSON object. Built with field()
+// calls on a temporary and handed to the Logger when it goes away:
+//
+//     LOG_INFO("mountpoint_created").field("camera", uuid).field("mountpoint", id);
+//
+// Values under password or authorization keys are replaced, and URL
+// credentials and Authorization headers are masked in every string value.
+class LogRecord
+{
+public:
+    LogRecord(LogLevel level, const char *event);
+    ~LogRecord();
+
+    LogRecord(const LogRecord &) = delete;
+    LogRecord &operator=(const LogRecord &) = delete;
+
+    LogRecord &field(const char *key, const QString &value);
+    LogRecord &field(const char *key, const QByteArray &value);
+    LogRecord &field(const char *key, const char *value);
+    LogRecord &field(const char *key, bool value);
+    LogRecord &field(const char *key, const QJsonObject &value);
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>>
+    LogRecord &field(const char *key, T value)
+    {
+        appendKey(key);
+        m_line += QByteArray::number(qlonglong(value));
+        return *this;
+    }
+
+    LogRecord &suppressed(quint64 count);
+
+private:
+    void appendKey(const char *key);
+
+    LogLevel m_level;
+    QByteArray m_line;
+};
+
+// Process-wide asynchronous log sink. Producers format their line and push
+// it into a bounded lock-free ring; one background thread drains the ring
+// to stderr, so the threads serving traffic never block on the terminal or
+// the journal. When the ring is full records are dropped and counted.
+// Once started, qDebug()/qWarning() output goes through the same path.
+class Logger
+{
+public:
+    static Logger &global();
+
+    // Starts the sink thread and takes over Qt's message handler
+    void start();
+    // Drains what is queued and stops the sink thread
+    void stop();
+
+    void setLevel(LogLevel level) { m_level.store(int(level), std::memory_order_relaxed); }
+    bool isEnabled(LogLevel level) const { return int(level) >= m_level.load(std::memory_order_relaxed); }
+    // "debug", "info", "warning" or "error"; anything else gives fallback
+    static LogLevel levelFromString(const QByteArray &name, LogLevel fallback = LogLevel::Info);
+
+    void submit(LogLevel level, QByteArray &&line);
+    quint64 droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Masks credentials in free text: URL user info, Authorization header
+    // values and JSON password fields
+    static QString redact(const QString &text);
+    static bool isSensitiveKey(const QString &key);
+
+private:
+    static constexpr size_t Capacity = 8192;   // power of two
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        QByteArray line;
+    };
+
+    Logger();
+    ~Logger();
+
+    bool tryPush(QByteArray &&line);
+    bool tryPop(QByteArray *line);
+    void runSink();
+    static void write(const QByteArray &data);
+
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+
+    std::atomic<int> m_level;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_sinkSleeping;
+    std::atomic<quint64> m_dropped;
+    QThread *m_sinkThread;
+    QMutex m_wakeMutex;
+    QWaitCondition m_wake;
+};
+
+#define CAMSTREAM_LOG(level, event) \
+    if constexpr (int(level) < CAMSTREAM_LOG_MIN_LEVEL) {} \
+    else if (!Logger::global().isEnabled(level)) {} \
+    else LogRecord(level, event)
+
+#define LOG_DEBUG(event) CAMSTREAM_LOG(LogLevel::Debug, event)
+#define LOG_INFO(event) CAMSTREAM_LOG(LogLevel::Info, event)
+#define LOG_WARNING(event) CAMSTREAM_LOG(LogLevel::Warning, event)
+#define LOG_ERROR(event) CAMSTREAM_LOG(LogLevel::Error, event)
+
+// For call sites that can fire per request or per camera in a burst
+#define LOG_RATE_LIMITED(level, perSecond, event) \
+    if constexpr (int(level) < CAMSTREAM_LOG_MIN_LEVEL) {} \
+    else if (static LogRateLimiter logLimiter_(perSecond); \
+             !Logger::global().isEnabled(level) || !logLimiter_.allow()) {} \
+    else LogRecord(level, event).suppressed(logLimiter_.takeSuppressed())
+
+#endif // LOGGER_H
@@ -1,13 +1,27 @@
 #include <QApplication>
 #include <QDebug>
 #include <QLoggingCategory>
+#include <QElapsedTimer>
 #include "mainwindow.h"
 #include "cameramanager.h"
+#include "logger.h"
+#include "metrics.h"
+#include "webviewpool.h"
 
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
+
+    // The core library is static; pull in its pages and scripts
+    Q_INIT_RESOURCE(resources);
+
     QApplication a(argc, argv);
 
+    // Log lines are written by a background thread from here on
+    Logger::global().setLevel(Logger::levelFromString(qgetenv("CAMSTREAM_LOG_LEVEL")));
+    Logger::global().start();
+
     QLoggingCategory::setFilterRules(
         "qt.qpa.*=false\n"           // Disable QPA (platform) logs
         "qt.text.*=false\n"          // Disable text/font logs
@@ -22,8 +36,12 @@ int main(int argc, char *argv[])
     MainWindow w;
     w.show();
 
+    // Local previews; declared first so it outlives the connectors using it
+    WebViewPool previewPool(4);
+
     // Create and configure camera manager
     CameraManager cameraManager;
+    cameraManager.setPreviewProvider(&previewPool);
 
     // Connect signals for monitoring
     QObject::connect(&cameraManager, &CameraManager::serviceStarted, []() {
@@ -56,8 +74,14 @@ int main(int argc, char *argv[])
     // Start the service
     if (!cameraManager.startService(8080)) {
         qCritical() << "Failed to start camera streaming service!";
+        Logger::global().stop();
         return -1;
     }
 
-    return a.exec();
+    Metrics::global().startupMicros.set(startup.nsecsElapsed() / 1000);
+    LOG_INFO("service_started").field("startup_ms", startup.elapsed()).field("rss_bytes", Metrics::residentBytes());
+
+    const int result = a.exec();
+    Logger::global().stop();
+    return result;
 }
@@ -0,0 +1,219 @@
+#include "metrics.h"
+#include <QFile>
+#include <QString>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+const qint64 BucketBoundsMicros[MetricHistogram::BucketCount] = {
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000
+};
+
+const char *const BucketLabels[MetricHistogram::BucketCount] = {
+    "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5",
+    "1", "2.5", "5", "10"
+};
+
+const char *const RouteNames[Metrics::RouteCount] = {
+    "camera", "cameras", "stream", "viewer", "static", "metrics", "other"
+};
+
+const char *const StatusClassNames[5] = { "1xx", "2xx", "3xx", "4xx", "5xx" };
+
+const char *const ConnectorStateNames[Metrics::ConnectorStateCount] = {
+    "idle", "reserved", "creating_mountpoint", "ready", "streaming"
+};
+
+const char *const StageNames[Metrics::StageCount] = {
+    "session_create", "attach", "keepalive", "create", "edit", "destroy", "list", "info", "other"
+};
+
+QByteArray seconds(qint64 micros)
+{
+    return QByteArray::number(double(micros) / 1e6, 'f', 6);
+}
+
+void writeCounter(QByteArray &out, const char *name, const char *help, quint64 value)
+{
+    writeMetricHeader(out, name, help, "counter");
+    out += name;
+    out += ' ';
+    out += QByteArray::number(value);
+    out += '\n';
+}
+
+} // namespace
+
+void MetricHistogram::observe(qint64 micros)
+{
+    int bucket = 0;
+    while (bucket < BucketCount && micros > BucketBoundsMicros[bucket]) bucket++;
+
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_sumMicros.fetch_add(quint64(qMax<qint64>(0, micros)), std::memory_order_relaxed);
+}
+
+void MetricHistogram::write(QByteArray &out, const QByteArray &name, const QByteArray &labels) const
+{
+    // Buckets are stored separately and reported cumulatively
+    const QByteArray prefix = labels.isEmpty() ? QByteArray() : labels + ',';
+    quint64 cumulative = 0;
+    for (int i = 0; i <= BucketCount; i++) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        out += name + "_bucket{" + prefix + "le=\"" + (i < BucketCount ? BucketLabels[i] : "+Inf") + "\"} "
+             + QByteArray::number(cumulative) + '\n';
+    }
+
+    const QByteArray braces = labels.isEmpty() ? QByteArray() : '{' + labels + '}';
+    out += name + "_sum" + braces + ' ' + seconds(m_sumMicros.load(std::memory_order_relaxed)) + '\n';
+    out += name + "_count" + braces + ' ' + QByteArray::number(cumulative) + '\n';
+}
+
+void writeMetricHeader(QByteArray &out, const char *name, const char *help, const char *type)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+Metrics &Metrics::global()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Route Metrics::routeFor(const QByteArray &method, const QByteArray &path)
+{
+    if (path.startsWith("/static/")) return RouteStatic;
+    if (path == "/metrics") return RouteMetrics;
+    if (path == "/cameras") return RouteCameras;
+    if (path.startsWith("/camera/")) return RouteCamera;
+    if (path.startsWith("/stream/")) {
+        return method == "POST" && path.endsWith("/viewer") ? RouteViewer : RouteStream;
+    }
+    return RouteOther;
+}
+
+Metrics::JanusStage Metrics::stageFor(const QString &request)
+{
+    if (request == QLatin1String("create")) return StageCreate;
+    if (request == QLatin1String("edit")) return StageEdit;
+    if (request == QLatin1String("destroy")) return StageDestroy;
+    if (request == QLatin1String("list")) return StageList;
+    if (request == QLatin1String("info")) return StageInfo;
+    return StageOther;
+}
+
+void Metrics::recordHttpRequest(Route route, int statusCode, qint64 micros)
+{
+    const int statusClass = qBound(1, statusCode / 100, 5) - 1;
+    httpRequests[route][statusClass].add();
+    httpDuration[route].observe(micros);
+}
+
+void Metrics::recordJanusRequest(JanusStage stage, qint64 micros, bool ok)
+{
+    janusRequests[stage].add();
+    if (!ok) janusErrors[stage].add();
+    janusDuration[stage].observe(micros);
+}
+
+void Metrics::connectorStateChanged(int from, int to)
+{
+    if (from >= 0 && from < ConnectorStateCount) connectors[from].sub();
+    if (to >= 0 && to < ConnectorStateCount) connectors[to].add();
+}
+
+qint64 Metrics::residentBytes()
+{
+#ifdef Q_OS_LINUX
+    // Second field of statm is resident pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+void Metrics::render(QByteArray &out) const
+{
+    out.reserve(out.size() + 16 * 1024);
+
+    writeMetricHeader(out, "camstream_http_requests_total", "HTTP requests by route and status class.", "counter");
+    for (int route = 0; route < RouteCount; route++) {
+        for (int statusClass = 0; statusClass < 5; statusClass++) {
+            const quint64 value = httpRequests[route][statusClass].value();
+            if (value == 0) continue;
+            out += QByteArray("camstream_http_requests_total{route=\"") + RouteNames[route]
+                 + "\",code=\"" + StatusClassNames[statusClass] + "\"} " + QByteArray::number(value) + '\n';
+        }
+    }
+
+    writeMetricHeader(out, "camstream_http_request_duration_seconds",
+                      "Time from a parsed request to its complete response.", "histogram");
+    for (int route = 0; route < RouteCount; route++) {
+        httpDuration[route].write(out, "camstream_http_request_duration_seconds",
+                                  QByteArray("route=\"") + RouteNames[route] + '"');
+    }
+
+    writeCounter(out, "camstream_http_response_bytes_total", "Bytes written to HTTP clients.", httpBytesSent.value());
+    writeCounter(out, "camstream_http_connections_total", "HTTP connections accepted.", httpConnections.value());
+    writeMetricHeader(out, "camstream_http_open_connections", "HTTP connections currently open.", "gauge");
+    out += "camstream_http_open_connections " + QByteArray::number(httpOpenConnections.value()) + '\n';
+    writeCounter(out, "camstream_stream_page_bytes_total", "Stream page bytes served (200 responses).",
+                 pageBytesServed.value());
+
+    writeMetricHeader(out, "camstream_connectors", "Camera connectors by state.", "gauge");
+    for (int state = 0; state < ConnectorStateCount; state++) {
+        out += QByteArray("camstream_connectors{state=\"") + ConnectorStateNames[state] + "\"} "
+             + QByteArray::number(connectors[state].value()) + '\n';
+    }
+
+    writeMetricHeader(out, "camstream_janus_requests_total", "Janus requests by stage.", "counter");
+    for (int stage = 0; stage < StageCount; stage++) {
+        out += QByteArray("camstream_janus_requests_total{stage=\"") + StageNames[stage] + "\"} "
+             + QByteArray::number(janusRequests[stage].value()) + '\n';
+    }
+    writeMetricHeader(out, "camstream_janus_errors_total", "Janus requests that failed, by stage.", "counter");
+    for (int stage = 0; stage < StageCount; stage++) {
+        out += QByteArray("camstream_janus_errors_total{stage=\"") + StageNames[stage] + "\"} "
+             + QByteArray::number(janusErrors[stage].value()) + '\n';
+    }
+    writeMetricHeader(out, "camstream_janus_request_duration_seconds",
+                      "Janus round trip, including the event for acknowledged requests.", "histogram");
+    for (int stage = 0; stage < StageCount; stage++) {
+        janusDuration[stage].write(out, "camstream_janus_request_duration_seconds",
+                                   QByteArray("stage=\"") + StageNames[stage] + '"');
+    }
+
+    writeCounter(out, "camstream_janus_keepalives_total", "Session keepalives sent.", keepAlivesSent.value());
+    writeCounter(out, "camstream_janus_keepalive_failures_total", "Session keepalives Janus rejected.",
+                 keepAlivesFailed.value());
+    writeCounter(out, "camstream_janus_keepalives_late_total", "Keepalives sent more than half a slot late.",
+                 keepAlivesLate.value());
+
+    writeMetricHeader(out, "camstream_setups_in_flight", "Camera setups talking to Janus.", "gauge");
+    out += "camstream_setups_in_flight " + QByteArray::number(setupsInFlight.value()) + '\n';
+    writeCounter(out, "camstream_setups_refused_total", "Cameras refused because the setup queue was full.",
+                 setupsRefused.value());
+
+    writeMetricHeader(out, "camstream_startup_seconds", "Time from process start to serving HTTP.", "gauge");
+    out += "camstream_startup_seconds " + seconds(startupMicros.value()) + '\n';
+    const qint64 resident = residentBytes();
+    if (resident >= 0) {
+        writeMetricHeader(out, "camstream_process_resident_memory_bytes", "Resident memory size.", "gauge");
+        out += "camstream_process_resident_memory_bytes " + QByteArray::number(resident) + '\n';
+    }
+}
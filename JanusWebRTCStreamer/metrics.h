@@ -0,0 +1,132 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <atomic>
+
+// Monotonic counter; cheap enough to bump from any thread on every request
+class MetricCounter
+{
+public:
+    void add(quint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> m_value{0};
+};
+
+class MetricGauge
+{
+public:
+    void add(qint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    void sub(qint64 n = 1) { m_value.fetch_sub(n, std::memory_order_relaxed); }
+    void set(qint64 n) { m_value.store(n, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> m_value{0};
+};
+
+// Latency histogram with fixed buckets from 1 ms to 10 s. Observing is a
+// short scan and two relaxed increments; nothing is allocated.
+class MetricHistogram
+{
+public:
+    static constexpr int BucketCount = 13;
+
+    void observe(qint64 micros);
+    void write(QByteArray &out, const QByteArray &name, const QByteArray &labels) const;
+
+private:
+    std::atomic<quint64> m_buckets[BucketCount + 1] = {};  // last is +Inf
+    std::atomic<quint64> m_sumMicros{0};
+};
+
+// Process-wide counters for GET /metrics, in Prometheus text format.
+// Everything is a relaxed atomic, so readers see each value on its own
+// rather than a consistent snapshot across values, which is fine for
+// scraping.
+class Metrics
+{
+public:
+    enum Route {
+        RouteCamera,
+        RouteCameras,
+        RouteStream,
+        RouteViewer,
+        RouteStatic,
+        RouteMetrics,
+        RouteOther,
+        RouteCount
+    };
+
+    // Same order as JanusConnector::State
+    enum ConnectorState {
+        ConnectorIdle,
+        ConnectorReserved,
+        ConnectorCreatingMountpoint,
+        ConnectorReady,
+        ConnectorStreaming,
+        ConnectorStateCount
+    };
+
+    // Janus round trips, by what was asked for
+    enum JanusStage {
+        StageSessionCreate,
+        StageAttach,
+        StageKeepAlive,
+        StageCreate,
+        StageEdit,
+        StageDestroy,
+        StageList,
+        StageInfo,
+        StageOther,
+        StageCount
+    };
+
+    static Metrics &global();
+
+    static Route routeFor(const QByteArray &method, const QByteArray &path);
+    static JanusStage stageFor(const QString &request);
+
+    void recordHttpRequest(Route route, int statusCode, qint64 micros);
+    void recordJanusRequest(JanusStage stage, qint64 micros, bool ok);
+    void connectorStateChanged(int from, int to);
+
+    // Resident set size of this process, or -1 where it is not known
+    static qint64 residentBytes();
+
+    // Appends every metric in text exposition format
+    void render(QByteArray &out) const;
+
+    MetricCounter httpRequests[RouteCount][5];      // by status class 1xx..5xx
+    MetricHistogram httpDuration[RouteCount];
+    MetricCounter httpBytesSent;
+    MetricCounter httpConnections;
+    MetricGauge httpOpenConnections;
+    MetricCounter pageBytesServed;
+
+    MetricGauge connectors[ConnectorStateCount];
+
+    MetricCounter janusRequests[StageCount];
+    MetricCounter janusErrors[StageCount];
+    MetricHistogram janusDuration[StageCount];
+    MetricCounter keepAlivesSent;
+    MetricCounter keepAlivesFailed;
+    MetricCounter keepAlivesLate;
+
+    MetricGauge setupsInFlight;
+    MetricCounter setupsRefused;
+
+    // Time from main() to the HTTP server listening, set once by main()
+    MetricGauge startupMicros;
+
+private:
+    Metrics() = default;
+};
+
+// Writes the "# HELP" and "# TYPE" lines for one metric family
+void writeMetricHeader(QByteArray &out, const char *name, const char *help, const char *type);
+
+#endif // METRICS_H
@@ -0,0 +1,367 @@
+#include "mountpointcatalog.h"
+#include "janussessionpool.h"
+#include "logger.h"
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QSet>
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+
+// info requests kept in flight while reconciling
+const int MaxInspectionsInFlight = 32;
+
+// Backoff between list attempts while Janus can't answer
+const int ListRetryInitialMs = 1000;
+const int ListRetryMaxMs = 30000;
+// Cameras waiting on the catalog fail after this many, so the retry
+// scheduler and the node's breaker pace them instead
+const int MaxListAttempts = 5;
+
+} // namespace
+
+MountpointCatalog::MountpointCatalog(JanusSessionPool *pool)
+    : QObject(pool)
+    , m_pool(pool)
+    , m_state(NotStarted)
+    , m_nextId(1)
+    , m_inspecting(0)
+    , m_listRetryMs(ListRetryInitialMs)
+    , m_listAttempts(0)
+    , m_rechecking(false)
+    , m_recheckAgain(false)
+    , m_recheckPending(false)
+{
+}
+
+void MountpointCatalog::reconcile()
+{
+    if (m_state != NotStarted) return;
+    m_state = Reconciling;
+    m_reconcileTimer.start();
+    listMountpoints();
+}
+
+void MountpointCatalog::listMountpoints()
+{
+    QJsonObject body;
+    body["request"] = "list";
+
+    JanusTransaction *transaction = m_pool->sendStreamingRequest(body);
+    connect(transaction, &JanusTransaction::succeeded, this, [this](const QJsonObject &data) {
+        const QJsonArray list = data["list"].toArray();
+        for (const QJsonValue &value : list) {
+            int id = value.toObject()["id"].toInt();
+            if (id <= 0) continue;
+            // A restored camera's reservation knows the credentials
+            const QByteArray credentials = m_entries.value(id).credentials;
+            Entry &entry = m_entries[id];
+            entry = Entry();
+            entry.credentials = credentials;
+            m_toInspect.append(id);
+        }
+
+        qDebug() << "Janus already has" << m_toInspect.size() << "mountpoints, inspecting";
+        for (int i = 0; i < MaxInspectionsInFlight; i++) {
+            inspectNext();
+        }
+        if (m_inspecting == 0) finishReconcile();
+    });
+    connect(transaction, &JanusTransaction::failed, this, [this](const QString &error) {
+        if (++m_listAttempts >= MaxListAttempts) {
+            LOG_WARNING("mountpoint_reconcile_failed").field("error", error).field("attempts", m_listAttempts);
+            m_state = NotStarted;
+            m_listAttempts = 0;
+            m_listRetryMs = ListRetryInitialMs;
+            emit reconcileFailed(error);
+            return;
+        }
+
+        // Cameras wait: without the list new IDs could take over mountpoints
+        // that survived on Janus
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "mountpoint_list_failed")
+            .field("error", error).field("retry_ms", m_listRetryMs);
+        QTimer::singleShot(m_listRetryMs, this, &MountpointCatalog::listMountpoints);
+        m_listRetryMs = qMin(m_listRetryMs * 2, ListRetryMaxMs);
+    });
+}
+
+void MountpointCatalog::recheck()
+{
+    // The first reconcile sees Janus as it is now anyway
+    if (m_state != Ready) return;
+    m_recheckPending = true;
+    if (m_rechecking) {
+        m_recheckAgain = true;
+        return;
+    }
+    m_rechecking = true;
+    m_recheckAgain = false;
+
+    // Only mountpoints created before the list was asked for can be missing
+    // from it; a create answered meanwhile may not be listed yet
+    QSet<int> live;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (!it->pending) live.insert(it.key());
+    }
+
+    QJsonObject body;
+    body["request"] = "list";
+
+    JanusTransaction *transaction = m_pool->sendStreamingRequest(body);
+    connect(transaction, &JanusTransaction::succeeded, this, [this, live](const QJsonObject &data) {
+        m_rechecking = false;
+        m_listAttempts = 0;
+        m_listRetryMs = ListRetryInitialMs;
+
+        QSet<int> listed;
+        const QJsonArray list = data["list"].toArray();
+        for (const QJsonValue &value : list) {
+            const int id = value.toObject()["id"].toInt();
+            if (id <= 0) continue;
+            listed.insert(id);
+            // Someone else's; its ID must not be handed out
+            if (!m_entries.contains(id)) m_entries.insert(id, Entry());
+        }
+
+        QList<int> lost;
+        for (int id : live) {
+            auto it = m_entries.find(id);
+            if (it == m_entries.end() || it->pending || listed.contains(id)) continue;
+
+            if (!it->url.isEmpty()) m_byUrl.remove(it->url, id);
+            if (it->claimed) {
+                it->url.clear();
+                it->metadata.clear();
+                it->pending = true;
+                lost.append(id);
+            } else {
+                m_entries.erase(it);
+            }
+        }
+
+        if (!lost.isEmpty()) {
+            LOG_WARNING("mountpoints_lost").field("count", lost.size()).field("listed", listed.size());
+            emit mountpointsLost(lost);
+        }
+        if (m_recheckAgain) {
+            recheck();
+        } else {
+            m_recheckPending = false;
+        }
+    });
+    connect(transaction, &JanusTransaction::failed, this, [this](const QString &error) {
+        m_rechecking = false;
+        if (++m_listAttempts >= MaxListAttempts) {
+            // The next re-established session asks again
+            LOG_WARNING("mountpoint_recheck_failed").field("error", error).field("attempts", m_listAttempts);
+            m_listAttempts = 0;
+            m_listRetryMs = ListRetryInitialMs;
+            return;
+        }
+
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "mountpoint_list_failed")
+            .field("error", error).field("retry_ms", m_listRetryMs);
+        QTimer::singleShot(m_listRetryMs, this, &MountpointCatalog::recheck);
+        m_listRetryMs = qMin(m_listRetryMs * 2, ListRetryMaxMs);
+    });
+}
+
+bool MountpointCatalog::isLive(int mountpointId) const
+{
+    auto it = m_entries.constFind(mountpointId);
+    return it != m_entries.cend() && !it->pending && !m_recheckPending;
+}
+
+void MountpointCatalog::inspectNext()
+{
+    if (m_toInspect.isEmpty()) return;
+    const int id = m_toInspect.takeLast();
+    m_inspecting++;
+
+    QJsonObject body;
+    body["request"] = "info";
+    body["id"] = id;
+
+    JanusTransaction *transaction = m_pool->sendStreamingRequest(body);
+    auto done = [this]() {
+        m_inspecting--;
+        inspectNext();
+        if (m_inspecting == 0) finishReconcile();
+    };
+    connect(transaction, &JanusTransaction::succeeded, this, [this, id, done](const QJsonObject &data) {
+        const QJsonObject info = data["info"].toObject();
+        Entry &entry = m_entries[id];
+        entry.url = info.contains("url") ? info["url"].toString() : info["rtsp_url"].toString();
+        entry.metadata = info["metadata"].toString();
+        if (!entry.url.isEmpty()) m_byUrl.insert(entry.url, id);
+        done();
+    });
+    connect(transaction, &JanusTransaction::failed, this, [id, done](const QString &error) {
+        // The ID stays reserved; it just can't be adopted
+        LOG_RATE_LIMITED(LogLevel::Warning, 5, "mountpoint_inspect_failed").field("mountpoint", id).field("error", error);
+        done();
+    });
+}
+
+void MountpointCatalog::finishReconcile()
+{
+    if (m_state == Ready) return;
+    m_state = Ready;
+
+    qDebug() << "Mountpoint catalog ready:" << m_byUrl.size() << "adoptable of"
+             << m_entries.size() << "in" << m_reconcileTimer.elapsed() << "ms";
+    emit ready();
+}
+
+int MountpointCatalog::adopt(const CameraParams &params)
+{
+    const QString metadata = metadataFor(params);
+    const QByteArray credentials = credentialsDigest(params);
+    for (auto it = m_byUrl.constFind(params.rtspUrl); it != m_byUrl.cend() && it.key() == params.rtspUrl; ++it) {
+        Entry &entry = m_entries[it.value()];
+        // Rotated credentials: the surviving mountpoint can't pull the source
+        if (!entry.claimed && entry.metadata == metadata && entry.credentials == credentials) {
+            entry.claimed = true;
+            return it.value();
+        }
+    }
+    return 0;
+}
+
+int MountpointCatalog::allocateId()
+{
+    while (m_entries.contains(m_nextId)) {
+        m_nextId++;
+    }
+
+    Entry reserved;
+    reserved.claimed = true;
+    reserved.pending = true;
+    m_entries.insert(m_nextId, reserved);
+    return m_nextId++;
+}
+
+void MountpointCatalog::reserve(int mountpointId, const CameraParams &params)
+{
+    if (mountpointId <= 0 || m_entries.contains(mountpointId)) return;
+
+    Entry reserved;
+    reserved.pending = true;
+    reserved.reservedFor = params.cameraUUID;
+    reserved.credentials = credentialsDigest(params);
+    m_entries.insert(mountpointId, reserved);
+}
+
+bool MountpointCatalog::claimReserved(int mountpointId, const QString &cameraUUID)
+{
+    auto it = m_entries.find(mountpointId);
+    if (it == m_entries.end() || !it->pending || it->claimed || it->reservedFor != cameraUUID) return false;
+
+    it->claimed = true;
+    return true;
+}
+
+void MountpointCatalog::unreserve(int mountpointId, const QString &cameraUUID)
+{
+    auto it = m_entries.find(mountpointId);
+    if (it != m_entries.end() && it->pending && !it->claimed && it->reservedFor == cameraUUID) m_entries.erase(it);
+}
+
+bool MountpointCatalog::serves(int mountpointId, const CameraParams &params) const
+{
+    auto it = m_entries.constFind(mountpointId);
+    if (it == m_entries.cend()) return false;
+    if (it->pending) return it->reservedFor == params.cameraUUID;
+    return it->url == params.rtspUrl && it->metadata == metadataFor(params);
+}
+
+void MountpointCatalog::recordCreated(int mountpointId, const CameraParams &params)
+{
+    Entry &entry = m_entries[mountpointId];
+    if (!entry.url.isEmpty()) m_byUrl.remove(entry.url, mountpointId);
+
+    entry.url = params.rtspUrl;
+    entry.metadata = metadataFor(params);
+    entry.credentials = credentialsDigest(params);
+    entry.claimed = true;
+    entry.pending = false;
+    entry.reservedFor.clear();
+    m_byUrl.insert(entry.url, mountpointId);
+}
+
+void MountpointCatalog::markDestroyed(int mountpointId, const QString &cameraUUID)
+{
+    auto it = m_entries.find(mountpointId);
+    if (it == m_entries.end()) return;
+
+    if (!it->url.isEmpty()) m_byUrl.remove(it->url, mountpointId);
+    it->url.clear();
+    it->metadata.clear();
+    it->pending = true;
+    it->reservedFor = cameraUUID;
+}
+
+void MountpointCatalog::unclaim(int mountpointId)
+{
+    auto it = m_entries.find(mountpointId);
+    if (it == m_entries.end()) return;
+
+    if (it->pending) {
+        m_entries.erase(it);
+    } else {
+        it->claimed = false;
+    }
+}
+
+void MountpointCatalog::release(int mountpointId)
+{
+    Entry entry = m_entries.take(mountpointId);
+    if (!entry.url.isEmpty()) m_byUrl.remove(entry.url, mountpointId);
+}
+
+int MountpointCatalog::destroyUnclaimed()
+{
+    if (m_state != Ready) return 0;
+
+    QList<int> orphaned;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (!it->claimed && !it->pending) orphaned.append(it.key());
+    }
+
+    for (int id : std::as_const(orphaned)) {
+        QJsonObject body;
+        body["request"] = "destroy";
+        body["id"] = id;
+        body["permanent"] = false;
+
+        // Fire and forget, like a connector's destroy; the ID is free either way
+        JanusTransaction *transaction = m_pool->sendStreamingRequest(body);
+        connect(transaction, &JanusTransaction::failed, transaction, [id](const QString &error) {
+            LOG_RATE_LIMITED(LogLevel::Warning, 10, "mountpoint_destroy_failed")
+                .field("mountpoint", id).field("error", error);
+        });
+        release(id);
+    }
+
+    if (!orphaned.isEmpty()) LOG_INFO("mountpoints_orphaned_destroyed").field("count", orphaned.size());
+    return orphaned.size();
+}
+
+QString MountpointCatalog::descriptionFor(const CameraParams &params)
+{
+    return QString("%1 - %2 Live Stream").arg(params.customerName, params.applianceName);
+}
+
+QByteArray MountpointCatalog::credentialsDigest(const CameraParams &params)
+{
+    return QCryptographicHash::hash(params.rtspUser.toUtf8() + '\0' + params.rtspPassword.toUtf8(),
+                                    QCryptographicHash::Sha256);
+}
+
+QString MountpointCatalog::metadataFor(const CameraParams &params)
+{
+    return QString("Camera: %1, Room: %2, School: %3")
+        .arg(params.cameraId, params.roomName, params.applianceName);
+}
@@ -0,0 +1,123 @@
+#ifndef MOUNTPOINTCATALOG_H
+#define MOUNTPOINTCATALOG_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QElapsedTimer>
+#include "cameraparams.h"
+
+class JanusSessionPool;
+
+// What one Janus node's streaming plugin already serves, and the mountpoint
+// ID allocator for that node. reconcile() lists the plugin's mountpoints and
+// fetches their details, so after a restart cameras adopt the mountpoint
+// that survived on Janus instead of recreating it (and making Janus pull the
+// RTSP source again), and new IDs never collide with existing ones.
+class MountpointCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MountpointCatalog(JanusSessionPool *pool);
+
+    // Runs once; ready() fires when it is done. A failed list is retried
+    // with backoff first: IDs handed out without it could collide with
+    // mountpoints that survived on Janus. After MaxListAttempts failures
+    // reconcileFailed() fires instead and the next reconcile() starts over.
+    void reconcile();
+    bool isReady() const { return m_state == Ready; }
+    // Lists the plugin's mountpoints again, e.g. after the pool's sessions
+    // were re-established: if Janus restarted, the mountpoints cameras hold
+    // are gone. Those are marked pending under their IDs, so they can be
+    // created again, and reported through mountpointsLost(). Only the IDs
+    // are listed; no details are fetched.
+    void recheck();
+    // Whether the mountpoint is known to exist on Janus: created or adopted,
+    // and not in doubt because a recheck() has not completed yet
+    bool isLive(int mountpointId) const;
+
+    // Returns the ID of an unclaimed mountpoint with this camera's RTSP URL,
+    // metadata and credentials and claims it, or 0 if there is none. Janus
+    // doesn't report credentials, so only mountpoints whose credentials are
+    // known from recordCreated() or reserve() can be adopted.
+    int adopt(const CameraParams &params);
+    // Reserves an ID that is not in use on Janus
+    int allocateId();
+    // Holds a camera's ID from the registry for it until it is set up
+    // again, so allocateId() can't hand it to another camera, and remembers
+    // the credentials it was created with. No-op if the ID is already known
+    // to be in use.
+    void reserve(int mountpointId, const CameraParams &params);
+    // Takes over an ID reserve()d for this camera; false if it is gone
+    bool claimReserved(int mountpointId, const QString &cameraUUID);
+    void unreserve(int mountpointId, const QString &cameraUUID);
+    // Whether a page pointing at this ID shows this camera: the ID is held
+    // for it, or the mountpoint on Janus has its RTSP URL and metadata
+    bool serves(int mountpointId, const CameraParams &params) const;
+    void recordCreated(int mountpointId, const CameraParams &params);
+    // The camera destroyed its mountpoint on Janus but keeps the ID, as an
+    // on-demand camera does while nobody watches. Not adoptable until
+    // recordCreated() again.
+    void markDestroyed(int mountpointId, const QString &cameraUUID);
+    // The camera let go of the mountpoint but it still exists on Janus; an
+    // allocated ID that was never created is freed instead
+    void unclaim(int mountpointId);
+    // The mountpoint was destroyed on Janus
+    void release(int mountpointId);
+    // Destroys the mountpoints on Janus no camera claimed, once every
+    // restored camera had its chance to adopt one. Returns how many.
+    int destroyUnclaimed();
+
+    int mountpointCount() const { return m_entries.size(); }
+
+    // Description and metadata set on the mountpoints we create
+    static QString descriptionFor(const CameraParams &params);
+    static QString metadataFor(const CameraParams &params);
+
+signals:
+    void ready();
+    void reconcileFailed(const QString &error);
+    void mountpointsLost(const QList<int> &mountpointIds);
+
+private:
+    enum State {
+        NotStarted,
+        Reconciling,
+        Ready
+    };
+
+    // Every ID known to be in use. Mountpoints whose details could not be
+    // fetched have an empty url and are never adopted.
+    struct Entry {
+        QString url;
+        QString metadata;
+        bool claimed = false;
+        bool pending = false;   // allocated, not created on Janus yet
+        QString reservedFor;    // camera a restored ID is held for
+        QByteArray credentials; // digest of the RTSP user and password, if known
+    };
+
+    static QByteArray credentialsDigest(const CameraParams &params);
+
+    void listMountpoints();
+    void inspectNext();
+    void finishReconcile();
+
+    JanusSessionPool *m_pool;
+    State m_state;
+    QHash<int, Entry> m_entries;
+    QMultiHash<QString, int> m_byUrl;
+    int m_nextId;
+
+    QList<int> m_toInspect;
+    int m_inspecting;
+    int m_listRetryMs;
+    int m_listAttempts;
+    bool m_rechecking;
+    bool m_recheckAgain;
+    bool m_recheckPending;      // sessions were re-established since the last listing
+    QElapsedTimer m_reconcileTimer;
+};
+
+#endif // MOUNTPOINTCATALOG_H
@@ -0,0 +1,23 @@
+#ifndef PREVIEWPROVIDER_H
+#define PREVIEWPROVIDER_H
+
+#include <QObject>
+#include <QString>
+
+// Local preview of a camera's stream. The core library only knows this
+// interface; the GUI app plugs in WebEngine views (WebViewPool) and the
+// headless daemon has no provider, so previews are refused there.
+class PreviewProvider : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+    // Shows html for connector, which the page reaches as "qtConnector".
+    // Returns false when no preview can be shown right now.
+    virtual bool showPreview(QObject *connector, const QString &html) = 0;
+    virtual void hidePreview(QObject *connector) = 0;
+};
+
+#endif // PREVIEWPROVIDER_H
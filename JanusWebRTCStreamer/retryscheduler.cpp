@@ -0,0 +1,179 @@
+#include "retryscheduler.h"
+#include <QRandomGenerator>
+#include <QDebug>
+#include "logger.h"
+
+namespace {
+
+// A probe that never reported back (e.g. its camera was replaced) stops
+// blocking the node after this long
+const qint64 ProbeTimeoutMs = 30000;
+
+} // namespace
+
+RetryScheduler::RetryScheduler(const Policy &policy, QObject *parent)
+    : QObject(parent)
+    , m_policy(policy)
+    , m_timer(new QTimer(this))
+{
+    m_clock.start();
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &RetryScheduler::onTimer);
+}
+
+void RetryScheduler::schedule(const QString &key)
+{
+    if (m_dueAt.contains(key) || m_ready.contains(key)) return;
+
+    // Equal jitter: half the backoff is fixed, the other half random
+    const int attempt = m_attempts.value(key);
+    m_attempts.insert(key, attempt + 1);
+    const qint64 backoff = qMin<qint64>(m_policy.maxDelayMs, qint64(m_policy.baseDelayMs) << qMin(attempt, 20));
+    const qint64 delay = backoff / 2 + QRandomGenerator::global()->bounded(backoff / 2 + 1);
+
+    const qint64 dueAt = m_clock.elapsed() + delay;
+    m_due.insert(dueAt, key);
+    m_dueAt.insert(key, dueAt);
+    armTimer();
+
+    LOG_DEBUG("retry_scheduled").field("key", key).field("delay_ms", delay).field("attempt", attempt + 1);
+}
+
+void RetryScheduler::cancel(const QString &key)
+{
+    auto it = m_dueAt.find(key);
+    if (it != m_dueAt.end()) {
+        m_due.remove(it.value(), key);
+        m_dueAt.erase(it);
+    }
+    m_ready.removeAll(key);
+    m_attempts.remove(key);
+    endAttempt(key);
+}
+
+bool RetryScheduler::tryAcquire(const QString &node)
+{
+    auto it = m_breakers.find(node);
+    if (it == m_breakers.end()) return true;
+
+    Breaker &breaker = it.value();
+    const qint64 now = m_clock.elapsed();
+
+    switch (breaker.state) {
+    case Closed:
+        return true;
+    case Open:
+        if (now < breaker.openUntil) return false;
+        breaker.state = HalfOpen;
+        breaker.probeStartedAt = -1;
+        Q_FALLTHROUGH();
+    case HalfOpen:
+        if (breaker.probeStartedAt >= 0 && now - breaker.probeStartedAt < ProbeTimeoutMs) {
+            // Wake the caller up if the probe never reports back
+            if (!breaker.probeWatchArmed) {
+                breaker.probeWatchArmed = true;
+                QTimer::singleShot(ProbeTimeoutMs - (now - breaker.probeStartedAt), this, [this, node]() {
+                    auto it = m_breakers.find(node);
+                    if (it == m_breakers.end()) return;
+                    it->probeWatchArmed = false;
+                    if (it->state == HalfOpen) emit nodeAvailable(node);
+                });
+            }
+            return false;
+        }
+        breaker.probeStartedAt = now;
+        LOG_INFO("circuit_half_open").field("node", node);
+        return true;
+    }
+    return true;
+}
+
+void RetryScheduler::recordSuccess(const QString &node, const QString &key)
+{
+    auto it = m_breakers.find(node);
+    if (it != m_breakers.end()) {
+        if (it->state != Closed) {
+            LOG_INFO("circuit_closed").field("node", node);
+        }
+        m_breakers.erase(it);
+    }
+
+    m_attempts.remove(key);
+    endAttempt(key);
+}
+
+void RetryScheduler::recordFailure(const QString &node, const QString &key)
+{
+    Breaker &breaker = m_breakers[node];
+    breaker.consecutiveFailures++;
+
+    if (breaker.state == HalfOpen) {
+        openBreaker(node, breaker);
+    } else if (breaker.state == Closed && breaker.consecutiveFailures >= m_policy.failureThreshold) {
+        openBreaker(node, breaker);
+    }
+
+    endAttempt(key);
+}
+
+bool RetryScheduler::isOpen(const QString &node) const
+{
+    auto it = m_breakers.constFind(node);
+    return it != m_breakers.cend() && it->state == Open && m_clock.elapsed() < it->openUntil;
+}
+
+void RetryScheduler::openBreaker(const QString &node, Breaker &breaker)
+{
+    breaker.openMs = breaker.openMs > 0 ? qMin(breaker.openMs * 2, m_policy.maxOpenMs) : m_policy.openMs;
+    breaker.openUntil = m_clock.elapsed() + breaker.openMs;
+    breaker.state = Open;
+    breaker.probeStartedAt = -1;
+
+    LOG_WARNING("circuit_open").field("node", node).field("open_ms", breaker.openMs)
+        .field("failures", breaker.consecutiveFailures);
+
+    QTimer::singleShot(breaker.openMs, this, [this, node]() {
+        auto it = m_breakers.constFind(node);
+        if (it != m_breakers.cend() && it->state == Open && m_clock.elapsed() >= it->openUntil) {
+            emit nodeAvailable(node);
+        }
+    });
+}
+
+void RetryScheduler::endAttempt(const QString &key)
+{
+    if (m_active.remove(key)) {
+        dispatchReady();
+    }
+}
+
+void RetryScheduler::onTimer()
+{
+    const qint64 now = m_clock.elapsed();
+    while (!m_due.isEmpty() && m_due.firstKey() <= now) {
+        const QString key = m_due.take(m_due.firstKey());
+        m_dueAt.remove(key);
+        m_ready.append(key);
+    }
+
+    dispatchReady();
+    armTimer();
+}
+
+void RetryScheduler::dispatchReady()
+{
+    while (m_active.size() < m_policy.maxConcurrentRetries && !m_ready.isEmpty()) {
+        const QString key = m_ready.takeFirst();
+        m_active.insert(key);
+        emit retryDue(key);
+    }
+}
+
+void RetryScheduler::armTimer()
+{
+    if (m_due.isEmpty()) {
+        m_timer->stop();
+        return;
+    }
+    m_timer->start(int(qMax<qint64>(0, m_due.firstKey() - m_clock.elapsed())));
+}
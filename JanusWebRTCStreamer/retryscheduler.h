@@ -0,0 +1,95 @@
+#ifndef RETRYSCHEDULER_H
+#define RETRYSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMultiMap>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Retries failed camera setups and keeps them from stampeding a Janus node.
+//
+// A failed setup is retried after an exponential backoff with jitter, so
+// cameras that failed together do not come back together. At most
+// maxConcurrentRetries retries are outstanding at once. Each Janus node
+// also has a circuit breaker: after failureThreshold failures in a row it
+// opens and tryAcquire() refuses setups for that node. When the open period
+// is over one probe setup is let through; its success closes the breaker,
+// its failure opens it again for twice as long.
+class RetryScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Policy {
+        int baseDelayMs = 1000;
+        int maxDelayMs = 60000;
+        int maxConcurrentRetries = 8;
+        int failureThreshold = 5;
+        int openMs = 5000;
+        int maxOpenMs = 60000;
+    };
+
+    explicit RetryScheduler(const Policy &policy = Policy(), QObject *parent = nullptr);
+
+    // Schedules the next attempt for key after a failure
+    void schedule(const QString &key);
+    // Drops pending and outstanding retries for key
+    void cancel(const QString &key);
+
+    // Circuit breaker: whether a setup may be sent to node now
+    bool tryAcquire(const QString &node);
+    // Outcome of a setup against node; also ends key's outstanding retry
+    void recordSuccess(const QString &node, const QString &key);
+    void recordFailure(const QString &node, const QString &key);
+
+    bool isOpen(const QString &node) const;
+    int scheduledCount() const { return m_dueAt.size() + m_ready.size(); }
+    int activeCount() const { return m_active.size(); }
+
+signals:
+    // Time to set key up again. Answer with recordSuccess/recordFailure,
+    // or cancel() if the attempt is not made.
+    void retryDue(const QString &key);
+    // node's breaker has left the open state; setups may be tried again
+    void nodeAvailable(const QString &node);
+
+private slots:
+    void onTimer();
+
+private:
+    enum BreakerState {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    struct Breaker {
+        BreakerState state = Closed;
+        int consecutiveFailures = 0;
+        int openMs = 0;
+        qint64 openUntil = 0;
+        qint64 probeStartedAt = -1;
+        bool probeWatchArmed = false;
+    };
+
+    void openBreaker(const QString &node, Breaker &breaker);
+    void endAttempt(const QString &key);
+    void dispatchReady();
+    void armTimer();
+
+    Policy m_policy;
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+
+    QMultiMap<qint64, QString> m_due;   // due time -> key
+    QHash<QString, qint64> m_dueAt;
+    QList<QString> m_ready;             // due, waiting for a retry slot
+    QSet<QString> m_active;
+    QHash<QString, int> m_attempts;
+    QHash<QString, Breaker> m_breakers;
+};
+
+#endif // RETRYSCHEDULER_H
@@ -0,0 +1,35 @@
+// Minimal in-tree replacement for webrtc-adapter. janus.js only reads
+// adapter.browserDetails, and the browsers we support ship the standard
+// WebRTC APIs, so there is nothing to shim beyond browser detection.
+(function(window) {
+    function detectBrowser() {
+        const result = { browser: null, version: null };
+        if (typeof window === 'undefined' || !window.navigator) {
+            result.browser = 'Not a browser.';
+            return result;
+        }
+
+        const userAgent = window.navigator.userAgent;
+        function extractVersion(regex, pos) {
+            const match = userAgent.match(regex);
+            return match && match.length >= pos && parseInt(match[pos], 10);
+        }
+
+        if (window.navigator.mozGetUserMedia) {
+            result.browser = 'firefox';
+            result.version = extractVersion(/Firefox\/(\d+)\./, 1);
+        } else if (window.navigator.webkitGetUserMedia ||
+                   (window.isSecureContext === false && window.webkitRTCPeerConnection)) {
+            result.browser = 'chrome';
+            result.version = extractVersion(/Chrom(e|ium)\/(\d+)\./, 2);
+        } else if (window.RTCPeerConnection && userAgent.match(/AppleWebKit\/(\d+)\./)) {
+            result.browser = 'safari';
+            result.version = extractVersion(/AppleWebKit\/(\d+)\./, 1);
+        } else {
+            result.browser = 'Not a supported browser.';
+        }
+        return result;
+    }
+
+    window.adapter = { browserDetails: detectBrowser() };
+})(typeof window !== 'undefined' ? window : undefined);
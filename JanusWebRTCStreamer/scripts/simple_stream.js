@@ -3,7 +3,36 @@ let streaming = null;
 let videoElement = document.getElementById('remotevideo');
 let statusElement = document.getElementById('status');
 let fsBtn = document.getElementById('fsBtn');
-let id = parseInt('{{MOUNTPOINT_ID}}');
+// Per-stream values come from the inline streamConfig so this file can be
+// served as a static, long-cached asset
+let id = streamConfig.mountpointId;
+
+// The server creates on-demand mountpoints when a viewer shows up, so the
+// first watch may come too early. Heartbeats tell it we are still watching;
+// they carry the viewer cookie set with this page, which the server checks.
+const viewerId = Math.random().toString(36).slice(2) + Date.now().toString(36);
+const beaconUrl = location.pathname.replace(/\/$/, '') + '/viewer';
+const heartbeatIntervalMs = 20000;
+const watchRetryDelayMs = 2000;
+const maxWatchRetries = 30;
+let watchRetries = 0;
+
+function sendViewerBeacon(event) {
+    const body = JSON.stringify({ viewer: viewerId, event: event });
+    if (navigator.sendBeacon) {
+        navigator.sendBeacon(beaconUrl, body);
+    } else {
+        fetch(beaconUrl, { method: 'POST', body: body, keepalive: true });
+    }
+}
+
+sendViewerBeacon('heartbeat');
+setInterval(function() { sendViewerBeacon('heartbeat'); }, heartbeatIntervalMs);
+window.addEventListener('pagehide', function() { sendViewerBeacon('leave'); });
+
+function watch() {
+    streaming.send({ message: { request: 'watch', id: id } });
+}
 
 function updateStatus(message) {
     statusElement.textContent = message;
@@ -26,16 +55,23 @@ Janus.init({
     callback: function() {
         updateStatus('Connecting to server...');
         janus = new Janus({
-            server: '{{JANUS_URL}}',
+            server: streamConfig.janusUrl,
             success: function() {
                 updateStatus('Connecting to stream...');
                 janus.attach({
                     plugin: 'janus.plugin.streaming',
                     success: function(pluginHandle) {
                         streaming = pluginHandle;
-                        streaming.send({ message: { request: 'watch', id: id } });
+                        watch();
                     },
                     onmessage: function(msg, jsep) {
+                        // 455: no such mountpoint (yet)
+                        if (msg.error_code === 455 && watchRetries < maxWatchRetries) {
+                            watchRetries++;
+                            updateStatus('Starting camera...');
+                            setTimeout(watch, watchRetryDelayMs);
+                            return;
+                        }
                         if (msg.error_code) {
                             updateStatus('Stream error: ' + msg.error);
                             return;
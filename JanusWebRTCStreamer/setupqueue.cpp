@@ -0,0 +1,253 @@
+#include "setupqueue.h"
+#include <QMutexLocker>
+
+namespace {
+
+// Clients refused for load are told to come back within this window
+const int MaxRetryAfterSeconds = 300;
+
+} // namespace
+
+SetupQueue::SetupQueue(int capacity, int customerCapacity)
+    : m_capacity(qMax(1, capacity))
+    , m_customerCapacity(qMax(1, customerCapacity))
+    , m_averageWaitMs(0)
+{
+    m_clock.start();
+}
+
+void SetupQueue::setLimits(int capacity, int customerCapacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax(1, capacity);
+    m_customerCapacity = qMax(1, customerCapacity);
+}
+
+SetupQueue::Admission SetupQueue::admit(const QHash<QString, int> &customerCounts) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    int total = 0;
+    for (auto it = customerCounts.cbegin(); it != customerCounts.cend(); ++it) {
+        total += it.value();
+    }
+    if (m_queued.size() + total > m_capacity) return QueueFull;
+
+    for (auto it = customerCounts.cbegin(); it != customerCounts.cend(); ++it) {
+        if (m_customerDepth.value(it.key()) + it.value() > m_customerCapacity) return CustomerFull;
+    }
+    return Admitted;
+}
+
+int SetupQueue::retryAfterSeconds() const
+{
+    QMutexLocker locker(&m_mutex);
+    return qBound<qint64>(1, (m_averageWaitMs + 999) / 1000, MaxRetryAfterSeconds);
+}
+
+void SetupQueue::push(const CameraParams &params, ProvisionAction action, bool priority)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Entry entry;
+    entry.params = params;
+    entry.action = action;
+    entry.priority = priority;
+    entry.queuedAt = m_clock.elapsed();
+
+    auto queued = m_queued.constFind(params.cameraUUID);
+    if (queued != m_queued.cend()) {
+        // Queued again before it started: latest parameters win and the
+        // camera keeps its place in line
+        const Lane::iterator position = queued.value();
+        entry.priority = entry.priority || position->priority;
+        entry.queuedAt = position->queuedAt;
+        if (entry.priority == position->priority && position->params.customerName == params.customerName) {
+            *position = entry;
+            return;
+        }
+        takeEntry(position);
+    }
+
+    insertEntry(entry, false);
+}
+
+void SetupQueue::pushFront(const Entry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // Queued again in the meantime; the newer entry wins
+    if (m_queued.contains(entry.params.cameraUUID)) return;
+    insertEntry(entry, true);
+}
+
+bool SetupQueue::pop(Entry *entry)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_priority.empty()) {
+        *entry = takeEntry(m_priority.begin());
+    } else if (!m_rotation.isEmpty()) {
+        // One camera per customer per turn; the customer goes to the back
+        const QString customer = m_rotation.takeFirst();
+        *entry = takeEntry(m_customers[customer].begin());
+        if (m_customers.contains(customer)) m_rotation.append(customer);
+    } else {
+        return false;
+    }
+
+    const qint64 waited = m_clock.elapsed() - entry->queuedAt;
+    m_averageWaitMs += (waited - m_averageWaitMs) / 8;
+    return true;
+}
+
+bool SetupQueue::promote(const QString &cameraUUID)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto queued = m_queued.constFind(cameraUUID);
+    if (queued == m_queued.cend()) return false;
+    if (queued.value()->priority) return true;
+
+    Entry entry = takeEntry(queued.value());
+    entry.priority = true;
+    insertEntry(entry, false);
+    return true;
+}
+
+void SetupQueue::remove(const QString &cameraUUID)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto queued = m_queued.constFind(cameraUUID);
+    if (queued != m_queued.cend()) takeEntry(queued.value());
+}
+
+QList<SetupQueue::Entry> SetupQueue::takeAll()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QList<Entry> entries(m_priority.cbegin(), m_priority.cend());
+    for (const QString &customer : std::as_const(m_rotation)) {
+        const Lane &lane = m_customers[customer];
+        entries.append(QList<Entry>(lane.cbegin(), lane.cend()));
+    }
+
+    m_priority.clear();
+    m_customers.clear();
+    m_rotation.clear();
+    m_queued.clear();
+    m_customerDepth.clear();
+    return entries;
+}
+
+bool SetupQueue::contains(const QString &cameraUUID, CameraParams *params) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_queued.constFind(cameraUUID);
+    if (it == m_queued.cend()) return false;
+    if (params) *params = it.value()->params;
+    return true;
+}
+
+bool SetupQueue::isEmpty() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queued.isEmpty();
+}
+
+int SetupQueue::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queued.size();
+}
+
+int SetupQueue::priorityCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_priority.size());
+}
+
+int SetupQueue::customerCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_customerDepth.size();
+}
+
+QHash<QString, int> SetupQueue::customerDepths() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_customerDepth;
+}
+
+qint64 SetupQueue::averageWaitMs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_averageWaitMs;
+}
+
+qint64 SetupQueue::oldestWaitMs() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_queued.isEmpty()) return 0;
+
+    // Customer lanes are FIFO; promoted cameras keep their original time
+    qint64 oldest = m_clock.elapsed();
+    for (const Entry &entry : m_priority) {
+        oldest = qMin(oldest, entry.queuedAt);
+    }
+    for (auto it = m_customers.cbegin(); it != m_customers.cend(); ++it) {
+        oldest = qMin(oldest, it.value().front().queuedAt);
+    }
+    return m_clock.elapsed() - oldest;
+}
+
+SetupQueue::Lane *SetupQueue::laneOf(const Entry &entry)
+{
+    if (entry.priority) return &m_priority;
+    auto customer = m_customers.find(entry.params.customerName);
+    return customer != m_customers.end() ? &customer.value() : nullptr;
+}
+
+void SetupQueue::insertEntry(const Entry &entry, bool atFront)
+{
+    const QString &customer = entry.params.customerName;
+
+    Lane::iterator position;
+    if (entry.priority) {
+        position = m_priority.insert(atFront ? m_priority.begin() : m_priority.end(), entry);
+    } else {
+        Lane &queue = m_customers[customer];
+        if (atFront) {
+            // A put-back camera resumes its customer's turn
+            m_rotation.removeOne(customer);
+            m_rotation.prepend(customer);
+            position = queue.insert(queue.begin(), entry);
+        } else {
+            if (queue.empty()) m_rotation.append(customer);
+            position = queue.insert(queue.end(), entry);
+        }
+    }
+
+    m_queued.insert(entry.params.cameraUUID, position);
+    m_customerDepth[customer]++;
+}
+
+SetupQueue::Entry SetupQueue::takeEntry(Lane::iterator position)
+{
+    Lane *lane = laneOf(*position);
+    Entry entry = std::move(*position);
+    lane->erase(position);
+    const QString customer = entry.params.customerName;
+
+    m_queued.remove(entry.params.cameraUUID);
+    if (--m_customerDepth[customer] <= 0) m_customerDepth.remove(customer);
+
+    if (lane != &m_priority && lane->empty()) {
+        m_customers.remove(customer);
+        m_rotation.removeOne(customer);
+    }
+    return entry;
+}
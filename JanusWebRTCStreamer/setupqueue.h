@@ -0,0 +1,99 @@
+#ifndef SETUPQUEUE_H
+#define SETUPQUEUE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QElapsedTimer>
+#include <list>
+#include "cameraparams.h"
+
+// What a POST for a camera turned into
+enum class ProvisionAction {
+    Created,
+    Unchanged,
+    Updated,    // Janus "edit" on the existing mountpoint
+    Recreated
+};
+
+// Cameras waiting for a Janus setup slot.
+//
+// Every customer gets its own FIFO and the queues are served round-robin,
+// one camera per customer per turn, so a district re-posting thousands of
+// cameras only delays its own cameras. Cameras someone is waiting to watch
+// go into a priority lane that is served first. A camera is queued at most
+// once; queueing it again replaces its parameters in place.
+//
+// admit() is called by the HTTP workers to refuse work before it is
+// queued; everything else runs on the manager's thread. All of it is
+// guarded by one mutex.
+class SetupQueue
+{
+public:
+    struct Entry {
+        CameraParams params;
+        ProvisionAction action = ProvisionAction::Created;
+        bool priority = false;
+        qint64 queuedAt = 0;
+    };
+
+    enum Admission {
+        Admitted,
+        CustomerFull,
+        QueueFull
+    };
+
+    explicit SetupQueue(int capacity = 10000, int customerCapacity = 5000);
+
+    void setLimits(int capacity, int customerCapacity);
+
+    // Whether count more cameras per customer fit. Checked before the
+    // cameras are queued, so concurrent requests can overshoot a little.
+    Admission admit(const QHash<QString, int> &customerCounts) const;
+    // How long a refused client should wait before trying again
+    int retryAfterSeconds() const;
+
+    void push(const CameraParams &params, ProvisionAction action, bool priority = false);
+    // Puts back an entry from pop() that could not be started yet
+    void pushFront(const Entry &entry);
+    bool pop(Entry *entry);
+    // Someone wants to watch the camera; move it to the priority lane
+    bool promote(const QString &cameraUUID);
+    void remove(const QString &cameraUUID);
+    QList<Entry> takeAll();
+
+    bool contains(const QString &cameraUUID, CameraParams *params = nullptr) const;
+    bool isEmpty() const;
+    int size() const;
+    int priorityCount() const;
+    int customerCount() const;
+    QHash<QString, int> customerDepths() const;
+    // Time spent queued, as a moving average over started setups and
+    // for the camera that has waited longest right now
+    qint64 averageWaitMs() const;
+    qint64 oldestWaitMs() const;
+
+private:
+    // Lanes are linked lists indexed by camera, so finding, replacing or
+    // taking out any queued camera is O(1) however long its lane is
+    using Lane = std::list<Entry>;
+
+    Lane *laneOf(const Entry &entry);
+    void insertEntry(const Entry &entry, bool atFront);
+    Entry takeEntry(Lane::iterator position);
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    int m_capacity;
+    int m_customerCapacity;
+
+    Lane m_priority;
+    QHash<QString, Lane> m_customers;           // customer -> FIFO
+    QList<QString> m_rotation;                  // customers with cameras queued, next first
+    QHash<QString, Lane::iterator> m_queued;    // camera -> its place in a lane
+    QHash<QString, int> m_customerDepth;        // both lanes
+    qint64 m_averageWaitMs;
+};
+
+#endif // SETUPQUEUE_H
@@ -0,0 +1,58 @@
+#include "streamregistry.h"
+
+StreamRegistry::StreamRegistry()
+    : m_size(0)
+{
+    for (ShardSlot &slot : m_shards) {
+        slot.snapshot = std::make_shared<const Shard>();
+    }
+}
+
+StreamRegistry::StreamPtr StreamRegistry::find(const StreamKey &key) const
+{
+    const ShardSlot &slot = m_shards[shardIndex(key.hash)];
+    std::shared_ptr<const Shard> shard = std::atomic_load_explicit(&slot.snapshot, std::memory_order_acquire);
+    return shard->value(key);
+}
+
+void StreamRegistry::insert(const QString &uuid, const StreamInfo &info)
+{
+    StreamKey key(uuid);
+    ShardSlot &slot = m_shards[shardIndex(key.hash)];
+
+    QMutexLocker locker(&slot.writeMutex);
+    auto updated = std::make_shared<Shard>(*slot.snapshot);
+    bool existed = updated->contains(key);
+    updated->insert(key, std::make_shared<const StreamInfo>(info));
+    std::atomic_store_explicit(&slot.snapshot, std::shared_ptr<const Shard>(std::move(updated)),
+                               std::memory_order_release);
+
+    if (!existed) m_size.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool StreamRegistry::remove(const QString &uuid)
+{
+    StreamKey key(uuid);
+    ShardSlot &slot = m_shards[shardIndex(key.hash)];
+
+    QMutexLocker locker(&slot.writeMutex);
+    if (!slot.snapshot->contains(key)) return false;
+
+    auto updated = std::make_shared<Shard>(*slot.snapshot);
+    updated->remove(key);
+    std::atomic_store_explicit(&slot.snapshot, std::shared_ptr<const Shard>(std::move(updated)),
+                               std::memory_order_release);
+
+    m_size.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void StreamRegistry::clear()
+{
+    for (ShardSlot &slot : m_shards) {
+        QMutexLocker locker(&slot.writeMutex);
+        std::atomic_store_explicit(&slot.snapshot, std::make_shared<const Shard>(),
+                                   std::memory_order_release);
+    }
+    m_size.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+#ifndef STREAMREGISTRY_H
+#define STREAMREGISTRY_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+#include <atomic>
+#include <memory>
+#include "cameraparams.h"
+
+struct StreamInfo {
+    CameraParams params;
+    int mountpointId = 0;
+    QString janusUrl;
+    QByteArray page;    // rendered UTF-8 stream page
+    QByteArray etag;    // strong validator for page
+};
+
+// Camera UUID with its hash computed once, used for both shard selection
+// and the lookup inside the shard
+struct StreamKey {
+    explicit StreamKey(const QString &uuid)
+        : uuid(uuid)
+        , hash(qHash(uuid))
+    {
+    }
+
+    bool operator==(const StreamKey &other) const
+    {
+        return hash == other.hash && uuid == other.uuid;
+    }
+
+    QString uuid;
+    size_t hash;
+};
+
+inline size_t qHash(const StreamKey &key, size_t seed = 0)
+{
+    return key.hash ^ seed;
+}
+
+// Stream registry built for many concurrent readers and rare writers.
+// Entries are spread over shards, each published as an immutable hash
+// snapshot. Readers atomically grab the current snapshot without taking the
+// shard's write mutex, so they never wait for a writer's copy; the atomic
+// shared_ptr load itself is not lock-free (libstdc++ briefly takes one of a
+// small global pool of mutexes). Writers copy one shard, modify the copy and
+// publish it (RCU style), so an update costs O(n / ShardCount) and readers
+// keep whatever they already hold.
+class StreamRegistry
+{
+public:
+    using StreamPtr = std::shared_ptr<const StreamInfo>;
+
+    StreamRegistry();
+
+    StreamPtr find(const StreamKey &key) const;
+    StreamPtr find(const QString &uuid) const { return find(StreamKey(uuid)); }
+
+    void insert(const QString &uuid, const StreamInfo &info);
+    bool remove(const QString &uuid);
+    void clear();
+
+    qsizetype size() const { return m_size.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int ShardBits = 6;
+    static constexpr int ShardCount = 1 << ShardBits;
+
+    using Shard = QHash<StreamKey, StreamPtr>;
+    struct ShardSlot {
+        std::shared_ptr<const Shard> snapshot;
+        QMutex writeMutex;      // serialises writers only
+    };
+
+    // The shard comes from the top bits; QHash buckets use the low ones
+    static int shardIndex(size_t hash) { return int(hash >> (sizeof(size_t) * 8 - ShardBits)); }
+
+    ShardSlot m_shards[ShardCount];
+    std::atomic<qsizetype> m_size;
+};
+
+#endif // STREAMREGISTRY_H
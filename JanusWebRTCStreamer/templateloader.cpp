@@ -1,99 +1,175 @@
 #include "templateloader.h"
 #include <QFile>
 #include <QDebug>
+#include <QMutex>
 
-QString templateloader::loadStreamTemplate(const CameraParams &params,
-                                           const QString &janusUrl,
-                                           int mountpointId,
-                                           const QString &janusJsContent)
+QByteArray templateloader::loadStreamTemplate(const CameraParams &params,
+                                              const QString &janusUrl,
+                                              int mountpointId,
+                                              const QByteArray &janusJsContent)
 {
     // Load HTML template
-    QString htmlTemplate = loadTemplate(":/templates/streaming.html");
-    if (htmlTemplate.isEmpty()) {
+    auto htmlTemplate = loadTemplate(":/templates/streaming.html");
+    if (!htmlTemplate) {
         qWarning() << "Failed to load HTML template";
-        return QString();
+        return QByteArray();
     }
 
     // Load JavaScript template
-    QString jsTemplate = loadTemplate(":/scripts/web-rtc.js");
-    if (jsTemplate.isEmpty()) {
+    auto jsTemplate = loadTemplate(":/scripts/web-rtc.js");
+    if (!jsTemplate) {
         qWarning() << "Failed to load JavaScript template";
-        return QString();
+        return QByteArray();
     }
 
     // Prepare variables for replacement
-    QMap<QString, QString> variables;
-    variables["ROOM_NAME"] = params.roomName;
-    variables["CUSTOMER_NAME"] = params.customerName;
-    variables["APPLIANCE_NAME"] = params.applianceName;
-    variables["JANUS_URL"] = janusUrl;
-    variables["MOUNTPOINT_ID"] = QString::number(mountpointId);
-    variables["JANUS_JS_CONTENT"] = janusJsContent;
+    Variables variables;
+    variables.insert("ROOM_NAME", params.roomName.toUtf8());
+    variables.insert("CUSTOMER_NAME", params.customerName.toUtf8());
+    variables.insert("APPLIANCE_NAME", params.applianceName.toUtf8());
+    variables.insert("JANUS_URL", janusUrl.toUtf8());
+    variables.insert("MOUNTPOINT_ID", QByteArray::number(mountpointId));
+    variables.insert("JANUS_JS_CONTENT", janusJsContent);
 
     // Process JavaScript template first
-    QString processedJs = processTemplate(jsTemplate, variables);
-    variables["WEBRTC_SCRIPT"] = processedJs;
+    variables.insert("WEBRTC_SCRIPT", render(*jsTemplate, variables));
 
     // Process HTML template
-    return processTemplate(htmlTemplate, variables);
+    return render(*htmlTemplate, variables);
 }
 
-QString templateloader::loadTemplate(const QString &templatePath)
+QByteArray templateloader::loadSimpleStreamTemplate(const CameraParams &params,
+                                                    const QString &janusUrl,
+                                                    int mountpointId,
+                                                    const QString &staticBaseUrl)
 {
-    QFile file(templatePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Cannot open template file:" << templatePath;
-        return QString();
+    // Load HTML template from file
+    auto htmlTemplate = loadTemplate(":/templates/simple_stream.html");
+    if (!htmlTemplate) {
+        qWarning() << "Failed to load simple HTML template";
+        return QByteArray();
     }
 
-    return QString::fromUtf8(file.readAll());
+    // Prepare variables for replacement
+    Variables variables;
+    variables.insert("ROOM_NAME", params.roomName.toUtf8());
+    variables.insert("CUSTOMER_NAME", params.customerName.toUtf8());
+    variables.insert("APPLIANCE_NAME", params.applianceName.toUtf8());
+    variables.insert("JANUS_URL", janusUrl.toUtf8());
+    variables.insert("MOUNTPOINT_ID", QByteArray::number(mountpointId));
+    variables.insert("STATIC_BASE", staticBaseUrl.toUtf8());
+
+    // Process HTML template
+    return render(*htmlTemplate, variables);
 }
 
-QString templateloader::loadSimpleStreamTemplate(const CameraParams &params,
-                                                 const QString &janusUrl,
-                                                 int mountpointId,
-                                                 const QString &janusJsContent)
+QString templateloader::processTemplate(const QString &templateContent,
+                                        const QMap<QString, QString> &variables)
 {
-    // Load HTML template from file
-    QString htmlTemplate = loadTemplate(":/templates/simple_stream.html");
-    if (htmlTemplate.isEmpty()) {
-        qWarning() << "Failed to load simple HTML template";
-        return QString();
+    Variables utf8Variables;
+    for (auto it = variables.begin(); it != variables.end(); ++it) {
+        utf8Variables.insert(it.key().toUtf8(), it.value().toUtf8());
     }
 
-    // Load JavaScript template from file
-    QString jsTemplate = loadTemplate(":/scripts/simple_stream.js");
-    if (jsTemplate.isEmpty()) {
-        qWarning() << "Failed to load simple JavaScript template";
-        return QString();
+    return QString::fromUtf8(render(compile(templateContent.toUtf8()), utf8Variables));
+}
+
+std::shared_ptr<const templateloader::CompiledTemplate> templateloader::loadTemplate(const QString &templatePath)
+{
+    // Templates live in the qrc and never change, so each is parsed once
+    static QMutex cacheMutex;
+    static QHash<QString, std::shared_ptr<const CompiledTemplate>> cache;
+
+    QMutexLocker locker(&cacheMutex);
+    auto it = cache.constFind(templatePath);
+    if (it != cache.constEnd()) {
+        return it.value();
     }
 
-    // Prepare variables for replacement
-    QMap<QString, QString> variables;
-    variables["ROOM_NAME"] = params.roomName;
-    variables["CUSTOMER_NAME"] = params.customerName;
-    variables["APPLIANCE_NAME"] = params.applianceName;
-    variables["JANUS_URL"] = janusUrl;
-    variables["MOUNTPOINT_ID"] = QString::number(mountpointId);
-    variables["JANUS_JS_CONTENT"] = janusJsContent;
+    QFile file(templatePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open template file:" << templatePath;
+        return nullptr;
+    }
 
-    // Process JavaScript template first
-    QString processedJs = processTemplate(jsTemplate, variables);
-    variables["SIMPLE_STREAM_SCRIPT"] = processedJs;
+    auto compiled = std::make_shared<const CompiledTemplate>(compile(file.readAll()));
+    cache.insert(templatePath, compiled);
+    return compiled;
+}
 
-    // Process HTML template
-    return processTemplate(htmlTemplate, variables);
+templateloader::CompiledTemplate templateloader::compile(const QByteArray &content)
+{
+    CompiledTemplate compiled;
+    qsizetype literalStart = 0;
+    qsizetype pos = 0;
+
+    auto appendLiteral = [&](qsizetype end) {
+        if (end > literalStart) {
+            Segment segment;
+            segment.text = content.mid(literalStart, end - literalStart);
+            compiled.literalSize += segment.text.size();
+            compiled.segments.append(segment);
+        }
+    };
+
+    // Placeholders are ASCII, so scanning the UTF-8 bytes directly is safe.
+    // Only {{NAME}} with NAME in [A-Z0-9_] is a slot; anything else stays literal.
+    while ((pos = content.indexOf("{{", pos)) != -1) {
+        qsizetype nameStart = pos + 2;
+        qsizetype nameEnd = nameStart;
+        while (nameEnd < content.size()) {
+            char c = content.at(nameEnd);
+            if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) break;
+            nameEnd++;
+        }
+
+        if (nameEnd == nameStart || !content.mid(nameEnd, 2).startsWith("}}")) {
+            pos = nameStart;
+            continue;
+        }
+
+        appendLiteral(pos);
+
+        Segment slot;
+        slot.text = content.mid(nameStart, nameEnd - nameStart);
+        slot.isVariable = true;
+        compiled.segments.append(slot);
+
+        pos = nameEnd + 2;
+        literalStart = pos;
+    }
+    appendLiteral(content.size());
+
+    return compiled;
 }
 
-QString templateloader::processTemplate(const QString &templateContent,
-                                        const QMap<QString, QString> &variables)
+QByteArray templateloader::render(const CompiledTemplate &compiled, const Variables &variables)
 {
-    QString result = templateContent;
+    // Size the output up front so rendering never reallocates
+    qsizetype size = compiled.literalSize;
+    for (const Segment &segment : compiled.segments) {
+        if (segment.isVariable) {
+            size += variables.value(segment.text).size() + segment.text.size() + 4;
+        }
+    }
 
-    // Replace all variables in format {{VARIABLE_NAME}}
-    for (auto it = variables.begin(); it != variables.end(); ++it) {
-        QString placeholder = QString("{{%1}}").arg(it.key());
-        result.replace(placeholder, it.value());
+    QByteArray result;
+    result.reserve(size);
+
+    // Substituted values are copied verbatim and never rescanned
+    for (const Segment &segment : compiled.segments) {
+        if (!segment.isVariable) {
+            result += segment.text;
+            continue;
+        }
+
+        auto it = variables.constFind(segment.text);
+        if (it != variables.constEnd()) {
+            result += it.value();
+        } else {
+            // Unknown variables are left in place, as before
+            result += "{{" + segment.text + "}}";
+        }
     }
 
     return result;
@@ -2,26 +2,46 @@
 #define TEMPLATELOADER_H
 
 #include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
 #include <QMap>
+#include <memory>
 #include "cameraparams.h"
 
 class templateloader
 {
 public:
-    static QString loadStreamTemplate(const CameraParams &params,
-                                      const QString &janusUrl,
-                                      int mountpointId,
-                                      const QString &janusJsContent);
-    static QString loadSimpleStreamTemplate(const CameraParams &params,
-                                            const QString &janusUrl,
-                                            int mountpointId,
-                                            const QString &janusJsContent);
+    // Rendered pages are returned UTF-8 encoded
+    static QByteArray loadStreamTemplate(const CameraParams &params,
+                                         const QString &janusUrl,
+                                         int mountpointId,
+                                         const QByteArray &janusJsContent);
+    // Scripts are referenced under staticBaseUrl instead of being inlined
+    static QByteArray loadSimpleStreamTemplate(const CameraParams &params,
+                                               const QString &janusUrl,
+                                               int mountpointId,
+                                               const QString &staticBaseUrl);
 
-private:
-    static QString loadTemplate(const QString &templatePath);
+    // Compiles and renders an ad-hoc template in one go (uncached)
     static QString processTemplate(const QString &templateContent,
                                    const QMap<QString, QString> &variables);
 
+private:
+    // A template is a list of literal runs and {{VARIABLE}} slots
+    struct Segment {
+        QByteArray text;        // literal bytes, or the variable name
+        bool isVariable = false;
+    };
+    struct CompiledTemplate {
+        QList<Segment> segments;
+        qsizetype literalSize = 0;
+    };
+    using Variables = QHash<QByteArray, QByteArray>;
+
+    static std::shared_ptr<const CompiledTemplate> loadTemplate(const QString &templatePath);
+    static CompiledTemplate compile(const QByteArray &content);
+    static QByteArray render(const CompiledTemplate &compiled, const Variables &variables);
 };
 
 #endif
@@ -0,0 +1,237 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <algorithm>
+#include <memory>
+#include "janustransport.h"
+#include "mockjanusserver.h"
+
+// WebSocketJanusTransport against MockJanusServer's WebSocket API: replies
+// matched by transaction, events pushed for watched sessions, and what
+// happens to requests when the socket drops or never connects.
+
+namespace {
+
+struct Reply {
+    bool received = false;
+    QJsonObject body;
+    QString error;
+};
+
+using ReplyPtr = std::shared_ptr<Reply>;
+
+JanusTransport::ReplyHandler recordInto(const ReplyPtr &reply)
+{
+    return [reply](const QJsonObject &body, const QString &error) {
+        reply->received = true;
+        reply->body = body;
+        reply->error = error;
+    };
+}
+
+QJsonObject janusRequest(const QString &kind, const QString &transaction)
+{
+    QJsonObject request;
+    request["janus"] = kind;
+    request["transaction"] = transaction;
+    return request;
+}
+
+quint16 freePort()
+{
+    QTcpServer probe;
+    if (!probe.listen(QHostAddress::LocalHost, 0)) return 0;
+    return probe.serverPort();
+}
+
+} // namespace
+
+class JanusTransportTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void repliesMatchTheirTransaction();
+    void pushesEventsForWatchedSessions();
+    void reconnectsAfterJanusRestarts();
+    void failsRequestsWhenConnectFails();
+
+private:
+    std::unique_ptr<MockJanusServer> startMock(const MockJanusServer::Options &options = {});
+    qint64 createSession(JanusTransport *transport);
+    qint64 attach(JanusTransport *transport, qint64 sessionId);
+
+    quint16 m_port = 0;
+    std::unique_ptr<WebSocketJanusTransport> m_transport;
+};
+
+void JanusTransportTest::init()
+{
+    m_port = freePort();
+    QVERIFY(m_port != 0);
+    m_transport.reset(new WebSocketJanusTransport(QString("ws://127.0.0.1:%1").arg(m_port)));
+}
+
+void JanusTransportTest::cleanup()
+{
+    m_transport.reset();
+}
+
+std::unique_ptr<MockJanusServer> JanusTransportTest::startMock(const MockJanusServer::Options &options)
+{
+    std::unique_ptr<MockJanusServer> mock(new MockJanusServer(options));
+    if (!mock->listen(0, m_port)) return nullptr;
+    return mock;
+}
+
+qint64 JanusTransportTest::createSession(JanusTransport *transport)
+{
+    ReplyPtr reply(new Reply);
+    transport->send(janusRequest("create", "tx-create"), 0, 0, recordInto(reply));
+    if (!QTest::qWaitFor([&reply]() { return reply->received; }, 5000)) return 0;
+    return reply->body["data"].toObject()["id"].toVariant().toLongLong();
+}
+
+qint64 JanusTransportTest::attach(JanusTransport *transport, qint64 sessionId)
+{
+    QJsonObject request = janusRequest("attach", "tx-attach");
+    request["plugin"] = "janus.plugin.streaming";
+
+    ReplyPtr reply(new Reply);
+    transport->send(request, sessionId, 0, recordInto(reply));
+    if (!QTest::qWaitFor([&reply]() { return reply->received; }, 5000)) return 0;
+    return reply->body["data"].toObject()["id"].toVariant().toLongLong();
+}
+
+void JanusTransportTest::repliesMatchTheirTransaction()
+{
+    // Jitter makes the mock answer out of order
+    MockJanusServer::Options options;
+    options.latencyMs = 1;
+    options.jitterMs = 30;
+    auto mock = startMock(options);
+    QVERIFY(mock);
+
+    const int Requests = 20;
+    QList<ReplyPtr> replies;
+    for (int i = 0; i < Requests; i++) {
+        replies.append(ReplyPtr(new Reply));
+        m_transport->send(janusRequest("create", QString("tx-%1").arg(i)), 0, 0, recordInto(replies.last()));
+    }
+
+    QTRY_VERIFY_WITH_TIMEOUT(std::all_of(replies.cbegin(), replies.cend(),
+                                         [](const ReplyPtr &reply) { return reply->received; }), 5000);
+
+    QSet<qint64> sessions;
+    for (int i = 0; i < Requests; i++) {
+        QVERIFY2(replies[i]->error.isEmpty(), qPrintable(replies[i]->error));
+        QCOMPARE(replies[i]->body["janus"].toString(), QString("success"));
+        QCOMPARE(replies[i]->body["transaction"].toString(), QString("tx-%1").arg(i));
+        sessions.insert(replies[i]->body["data"].toObject()["id"].toVariant().toLongLong());
+    }
+    QCOMPARE(sessions.size(), Requests);
+    QCOMPARE(mock->sessionCount(), Requests);
+}
+
+void JanusTransportTest::pushesEventsForWatchedSessions()
+{
+    MockJanusServer::Options options;
+    options.asyncPlugin = true;
+    auto mock = startMock(options);
+    QVERIFY(mock);
+
+    const qint64 sessionId = createSession(m_transport.get());
+    QVERIFY(sessionId > 0);
+    m_transport->watchSession(sessionId);
+    const qint64 handleId = attach(m_transport.get(), sessionId);
+    QVERIFY(handleId > 0);
+
+    QSignalSpy events(m_transport.get(), &JanusTransport::eventReceived);
+
+    QJsonObject body;
+    body["request"] = "list";
+    QJsonObject message = janusRequest("message", "tx-list");
+    message["body"] = body;
+
+    ReplyPtr reply(new Reply);
+    m_transport->send(message, sessionId, handleId, recordInto(reply));
+
+    // The ack completes the request; the answer follows as an event
+    QTRY_VERIFY_WITH_TIMEOUT(reply->received, 5000);
+    QVERIFY2(reply->error.isEmpty(), qPrintable(reply->error));
+    QCOMPARE(reply->body["janus"].toString(), QString("ack"));
+
+    QTRY_COMPARE_WITH_TIMEOUT(events.count(), 1, 5000);
+    QCOMPARE(events.at(0).at(0).toLongLong(), sessionId);
+    const QJsonObject event = events.at(0).at(1).value<QJsonObject>();
+    QCOMPARE(event["janus"].toString(), QString("event"));
+    QCOMPARE(event["transaction"].toString(), QString("tx-list"));
+    QCOMPARE(event["plugindata"].toObject()["data"].toObject()["streaming"].toString(), QString("list"));
+
+    // Unwatched sessions get nothing
+    m_transport->unwatchSession(sessionId);
+    message["transaction"] = "tx-list-unwatched";
+    ReplyPtr unwatched(new Reply);
+    m_transport->send(message, sessionId, handleId, recordInto(unwatched));
+    QTRY_VERIFY_WITH_TIMEOUT(unwatched->received, 5000);
+    QTest::qWait(100);
+    QCOMPARE(events.count(), 1);
+}
+
+void JanusTransportTest::reconnectsAfterJanusRestarts()
+{
+    MockJanusServer::Options options;
+    options.latencyMs = 200;
+    auto mock = startMock(options);
+    QVERIFY(mock);
+
+    const qint64 sessionId = createSession(m_transport.get());
+    QVERIFY(sessionId > 0);
+    m_transport->watchSession(sessionId);
+
+    QSignalSpy lost(m_transport.get(), &JanusTransport::sessionEventsFailed);
+
+    // Still waiting for its reply when Janus goes away
+    ReplyPtr inFlight(new Reply);
+    m_transport->send(janusRequest("keepalive", "tx-keepalive"), sessionId, 0, recordInto(inFlight));
+    QTest::qWait(50);
+    mock.reset();
+
+    QTRY_VERIFY_WITH_TIMEOUT(inFlight->received, 5000);
+    QVERIFY(!inFlight->error.isEmpty());
+    QTRY_COMPARE_WITH_TIMEOUT(lost.count(), 1, 5000);
+    QCOMPARE(lost.at(0).at(0).toLongLong(), sessionId);
+
+    // The next request opens a new socket to the restarted node
+    mock = startMock();
+    QVERIFY(mock);
+    const qint64 newSessionId = createSession(m_transport.get());
+    QVERIFY(newSessionId > 0);
+    QCOMPARE(mock->sessionCount(), 1);
+}
+
+void JanusTransportTest::failsRequestsWhenConnectFails()
+{
+    // Nothing listens yet: the request fails with the connect, not after
+    // the 10 second request timeout
+    ReplyPtr refused(new Reply);
+    m_transport->send(janusRequest("create", "tx-refused"), 0, 0, recordInto(refused));
+    QTRY_VERIFY_WITH_TIMEOUT(refused->received, 5000);
+    QVERIFY(!refused->error.isEmpty());
+
+    // Once Janus is up, only the new request reaches it; the failed
+    // create is not replayed into an orphaned session
+    auto mock = startMock();
+    QVERIFY(mock);
+    const qint64 sessionId = createSession(m_transport.get());
+    QVERIFY(sessionId > 0);
+    QTest::qWait(100);
+    QCOMPARE(mock->sessionCount(), 1);
+}
+
+QTEST_GUILESS_MAIN(JanusTransportTest)
+
+#include "janustransporttest.moc"
@@ -0,0 +1,222 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QDebug>
+#include <memory>
+#include "loadgenerator.h"
+
+// Load generator for the camera streaming service. Against a running
+// service it only drives traffic (--target). With --daemon and
+// --mock-janus it is the end-to-end harness: it starts a mock Janus and
+// the daemon on free local ports, runs the load, stops both and checks
+// the result, which is how the CTest load tests use it.
+//
+// The report is one JSON object on stdout, and in --output if given.
+
+namespace {
+
+quint16 freePort()
+{
+    QTcpServer probe;
+    probe.listen(QHostAddress::LocalHost, 0);
+    return probe.serverPort();
+}
+
+bool waitForListening(QProcess &process, quint16 port, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < timeoutMs && process.state() == QProcess::Running) {
+        QTcpSocket probe;
+        probe.connectToHost(QHostAddress::LocalHost, port);
+        if (probe.waitForConnected(50)) return true;
+        QThread::msleep(10);
+    }
+    return false;
+}
+
+std::unique_ptr<QProcess> startProcess(const QString &program, const QStringList &arguments,
+                                       const QProcessEnvironment &environment, quint16 port)
+{
+    std::unique_ptr<QProcess> process(new QProcess);
+    process->setProcessEnvironment(environment);
+    process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process->start(program, arguments);
+
+    if (!process->waitForStarted(5000) || !waitForListening(*process, port, 30000)) {
+        qWarning().noquote() << program << "did not start listening on port" << port;
+        return nullptr;
+    }
+    return process;
+}
+
+void stopProcess(QProcess *process)
+{
+    if (!process || process->state() == QProcess::NotRunning) return;
+    process->terminate();
+    if (!process->waitForFinished(10000)) {
+        process->kill();
+        process->waitForFinished(2000);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("camstream_loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Camera provisioning and stream page load generator");
+    parser.addHelpOption();
+    QCommandLineOption targetOption("target", "Service base URL.", "url", "http://127.0.0.1:8080");
+    QCommandLineOption camerasOption("cameras", "Cameras to provision.", "count", "1000");
+    QCommandLineOption setupRateOption("setup-rate", "POST /camera requests per second.", "rate", "100");
+    QCommandLineOption pageRateOption("page-rate", "GET /stream requests per second.", "rate", "500");
+    QCommandLineOption pageSecondsOption("page-seconds", "How long to fetch stream pages.", "seconds", "10");
+    QCommandLineOption connectionsOption("connections", "HTTP connections to the service.", "count", "60");
+    QCommandLineOption setupTimeoutOption("setup-timeout", "Give up on unanswered setups after this long.",
+                                          "seconds", "120");
+    QCommandLineOption userOption("user", "Stream page user (default $CAMSTREAM_STREAM_USER).", "name");
+    QCommandLineOption passwordOption("password", "Stream page password (default $CAMSTREAM_STREAM_PASSWORD).",
+                                      "password");
+    QCommandLineOption outputOption("output", "Also write the JSON report here.", "path");
+
+    QCommandLineOption daemonOption("daemon", "Start this daemon binary and load it.", "path");
+    QCommandLineOption mockJanusOption("mock-janus", "Start this mock Janus binary for the daemon.", "path");
+    QCommandLineOption transportOption("janus-transport", "How the daemon talks to Janus: http or ws.",
+                                       "transport", "http");
+    QCommandLineOption janusLatencyOption("janus-latency-ms", "Mock Janus reply latency.", "ms", "5");
+    QCommandLineOption janusFailureOption("janus-failure-rate", "Mock Janus mountpoint create failure rate.",
+                                          "rate", "0");
+    QCommandLineOption minReadyOption("min-ready", "Fail unless this share of cameras became ready.",
+                                      "fraction", "1");
+    QCommandLineOption maxPageP99Option("max-page-p99-ms", "Fail if the page p99 is above this, 0 for no limit.",
+                                        "ms", "0");
+    parser.addOptions({ targetOption, camerasOption, setupRateOption, pageRateOption, pageSecondsOption,
+                        connectionsOption, setupTimeoutOption, userOption, passwordOption, outputOption,
+                        daemonOption, mockJanusOption, transportOption, janusLatencyOption, janusFailureOption,
+                        minReadyOption, maxPageP99Option });
+    parser.process(app);
+
+    LoadGenerator::Options options;
+    options.target = QUrl(parser.value(targetOption));
+    options.cameras = qMax(1, parser.value(camerasOption).toInt());
+    options.setupRate = parser.value(setupRateOption).toDouble();
+    options.pageRate = parser.value(pageRateOption).toDouble();
+    options.pageSeconds = parser.value(pageSecondsOption).toInt();
+    options.connections = parser.value(connectionsOption).toInt();
+    options.setupTimeoutSec = parser.value(setupTimeoutOption).toInt();
+    options.user = parser.isSet(userOption) ? parser.value(userOption)
+                                            : QString::fromUtf8(qgetenv("CAMSTREAM_STREAM_USER"));
+    options.password = parser.isSet(passwordOption) ? parser.value(passwordOption)
+                                                    : QString::fromUtf8(qgetenv("CAMSTREAM_STREAM_PASSWORD"));
+
+    // Harness mode: mock Janus and daemon on free local ports
+    std::unique_ptr<QProcess> mockJanus;
+    std::unique_ptr<QProcess> daemon;
+    // The daemon's camera registry lives here, so runs start empty and leave
+    // the user's own registry alone
+    QTemporaryDir registryDir;
+    const QString transport = parser.value(transportOption);
+    if (parser.isSet(daemonOption)) {
+        if (!parser.isSet(mockJanusOption)) {
+            qWarning() << "--daemon needs --mock-janus";
+            return 2;
+        }
+        if (transport != "http" && transport != "ws") {
+            qWarning() << "--janus-transport must be http or ws";
+            return 2;
+        }
+
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("CAMSTREAM_LOG_LEVEL", "warning");
+        if (options.user.isEmpty()) {
+            options.user = "loadtest";
+            options.password = "loadtest-password";
+        }
+        environment.insert("CAMSTREAM_STREAM_USER", options.user);
+        environment.insert("CAMSTREAM_STREAM_PASSWORD", options.password);
+
+        const quint16 janusPort = freePort();
+        const quint16 janusWsPort = freePort();
+        mockJanus = startProcess(parser.value(mockJanusOption),
+                                 { "--port", QString::number(janusPort), "--ws-port", QString::number(janusWsPort),
+                                   "--latency-ms", parser.value(janusLatencyOption),
+                                   "--failure-rate", parser.value(janusFailureOption) },
+                                 environment, janusPort);
+        if (!mockJanus) return 2;
+
+        const QString janusUrl = transport == "ws" ? QString("ws://127.0.0.1:%1").arg(janusWsPort)
+                                                   : QString("http://127.0.0.1:%1/janus").arg(janusPort);
+        if (!registryDir.isValid()) {
+            qWarning() << "Cannot create a temporary directory for the camera registry";
+            stopProcess(mockJanus.get());
+            return 2;
+        }
+        const quint16 daemonPort = freePort();
+        daemon = startProcess(parser.value(daemonOption),
+                              { "--port", QString::number(daemonPort), "--janus-url", janusUrl,
+                                "--registry", registryDir.filePath("cameras.jsonl") },
+                              environment, daemonPort);
+        if (!daemon) {
+            stopProcess(mockJanus.get());
+            return 2;
+        }
+        options.target = QUrl(QString("http://127.0.0.1:%1").arg(daemonPort));
+    }
+
+    LoadGenerator generator(options);
+    QObject::connect(&generator, &LoadGenerator::finished, &app, &QCoreApplication::quit);
+    generator.start();
+    app.exec();
+
+    stopProcess(daemon.get());
+    stopProcess(mockJanus.get());
+
+    QJsonObject report = generator.report();
+    if (daemon) {
+        report["janus_transport"] = transport;
+        report["janus_latency_ms"] = parser.value(janusLatencyOption).toInt();
+    }
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    out.write(json);
+    out.close();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Cannot write report to" << file.fileName();
+        } else {
+            file.write(json);
+        }
+    }
+
+    // Pass/fail for CTest
+    const double readyShare = double(report["ready"].toInt()) / options.cameras;
+    if (readyShare < parser.value(minReadyOption).toDouble()) {
+        qWarning() << "Only" << report["ready"].toInt() << "of" << options.cameras << "cameras became ready";
+        return 1;
+    }
+    const double maxPageP99 = parser.value(maxPageP99Option).toDouble();
+    if (maxPageP99 > 0 && report["page_p99_ms"].toDouble() > maxPageP99) {
+        qWarning() << "Page p99" << report["page_p99_ms"].toDouble() << "ms is above" << maxPageP99 << "ms";
+        return 1;
+    }
+    if (report["page_errors"].toInteger() > 0) {
+        qWarning() << report["page_errors"].toInteger() << "stream page requests failed";
+        return 1;
+    }
+    return 0;
+}
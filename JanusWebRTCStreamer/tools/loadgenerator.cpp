@@ -0,0 +1,255 @@
+#include "loadgenerator.h"
+#include <QJsonDocument>
+#include <QNetworkReply>
+#include <QUuid>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// QNetworkAccessManager opens at most this many connections per host
+const int ConnectionsPerManager = 6;
+
+// Pages still outstanding this long after the page phase are given up on
+const int PageDrainMs = 30000;
+
+} // namespace
+
+LoadGenerator::LoadGenerator(const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_nextManager(0)
+    , m_phase(Idle)
+    , m_posted(0)
+    , m_answered(0)
+    , m_ready(0)
+    , m_failed(0)
+    , m_refused(0)
+    , m_lastReadyMicros(0)
+    , m_pagesSent(0)
+    , m_pagesAnswered(0)
+    , m_pageErrors(0)
+    , m_pageBytes(0)
+    , m_residentBytes(-1)
+{
+    const int managers = qMax(1, (m_options.connections + ConnectionsPerManager - 1) / ConnectionsPerManager);
+    for (int i = 0; i < managers; i++) {
+        m_managers.append(new QNetworkAccessManager(this));
+    }
+
+    m_ticker.setInterval(1);
+    m_ticker.setTimerType(Qt::PreciseTimer);
+    connect(&m_ticker, &QTimer::timeout, this, &LoadGenerator::tick);
+}
+
+void LoadGenerator::start()
+{
+    if (m_phase != Idle) return;
+
+    qInfo() << "Provisioning" << m_options.cameras << "cameras at" << m_options.setupRate << "/s against"
+            << m_options.target.toString();
+    m_phase = Setup;
+    m_phaseTimer.start();
+    m_ticker.start();
+}
+
+void LoadGenerator::tick()
+{
+    const qint64 elapsedMs = m_phaseTimer.elapsed();
+
+    if (m_phase == Setup) {
+        // Open loop: send whatever is due by now, however the service keeps up
+        const int due = int(qMin<double>(m_options.cameras, elapsedMs * m_options.setupRate / 1000.0));
+        while (m_posted < due) postCamera(m_posted++);
+
+        if (elapsedMs > m_options.setupTimeoutSec * 1000LL) {
+            qWarning() << "Setup phase timed out with" << m_posted - m_answered << "cameras unanswered";
+            finishSetup();
+        }
+    } else if (m_phase == Pages) {
+        if (elapsedMs < m_options.pageSeconds * 1000LL) {
+            const qint64 due = qint64(elapsedMs * m_options.pageRate / 1000.0);
+            while (m_pagesSent < due) getPage();
+        } else if (m_pagesAnswered == m_pagesSent || elapsedMs > m_options.pageSeconds * 1000LL + PageDrainMs) {
+            finishPages();
+        }
+    }
+}
+
+void LoadGenerator::postCamera(int index)
+{
+    const QString uuid = QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+    // Ten customers so the setup queue's fair rotation is exercised
+    QJsonObject camera;
+    camera["camera_id"] = uuid;
+    camera["customer_name"] = QString("loadtest-customer-%1").arg(index % 10);
+    camera["appliance_name"] = QString("loadtest-appliance-%1").arg(index / 100);
+    camera["room_name"] = QString("Room %1").arg(index);
+    camera["ip"] = QString("10.%1.%2.%3:554").arg((index >> 16) & 0xff).arg((index >> 8) & 0xff).arg(index & 0xff);
+
+    QNetworkRequest post = request("/camera/" + uuid);
+    post.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    post.setTransferTimeout(m_options.setupTimeoutSec * 1000);
+
+    QElapsedTimer timer;
+    timer.start();
+    QNetworkReply *reply = nextManager()->post(post, QJsonDocument(camera).toJson(QJsonDocument::Compact));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, uuid, timer]() {
+        reply->deleteLater();
+        if (m_phase != Setup) return;
+        m_answered++;
+
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 429 || status == 503) {
+            m_refused++;
+        } else if (reply->error() != QNetworkReply::NoError) {
+            m_failed++;
+        } else {
+            // One JSON line per camera; this request only carries one
+            const QJsonObject result = QJsonDocument::fromJson(reply->readAll().trimmed()).object();
+            if (result["status"].toString() == "ready") {
+                m_ready++;
+                m_setupMicros.append(timer.nsecsElapsed() / 1000);
+                m_lastReadyMicros = m_phaseTimer.nsecsElapsed() / 1000;
+                m_readyCameras.append(uuid);
+            } else {
+                m_failed++;
+            }
+        }
+
+        if (m_posted == m_options.cameras && m_answered == m_posted) finishSetup();
+    });
+}
+
+void LoadGenerator::finishSetup()
+{
+    if (m_phase != Setup) return;
+
+    qInfo() << "Setup done:" << m_ready << "ready," << m_failed << "failed," << m_refused << "refused in"
+            << m_lastReadyMicros / 1000 << "ms";
+
+    m_phase = Pages;
+    if (m_readyCameras.isEmpty() || m_options.pageSeconds <= 0 || m_options.pageRate <= 0) {
+        finishPages();
+        return;
+    }
+
+    qInfo() << "Fetching stream pages at" << m_options.pageRate << "/s for" << m_options.pageSeconds << "s";
+    m_phaseTimer.restart();
+}
+
+void LoadGenerator::getPage()
+{
+    const QString uuid = m_readyCameras[m_pagesSent % m_readyCameras.size()];
+    m_pagesSent++;
+
+    QElapsedTimer timer;
+    timer.start();
+    QNetworkReply *reply = nextManager()->get(request("/stream/" + uuid));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, timer]() {
+        reply->deleteLater();
+        if (m_phase != Pages) return;
+        m_pagesAnswered++;
+
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() != QNetworkReply::NoError || (status != 200 && status != 304)) {
+            m_pageErrors++;
+            return;
+        }
+        m_pageBytes += reply->readAll().size();
+        m_pageMicros.append(timer.nsecsElapsed() / 1000);
+    });
+}
+
+void LoadGenerator::finishPages()
+{
+    if (m_phase != Pages) return;
+    m_ticker.stop();
+
+    if (m_pagesSent > 0) {
+        qInfo() << "Pages done:" << m_pagesAnswered << "answered," << m_pageErrors << "errors";
+    }
+    scrapeMetrics();
+}
+
+void LoadGenerator::scrapeMetrics()
+{
+    m_phase = Scrape;
+
+    QNetworkReply *reply = nextManager()->get(request("/metrics"));
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+
+        const QList<QByteArray> lines = reply->readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("camstream_process_resident_memory_bytes ")) {
+                m_residentBytes = line.mid(line.indexOf(' ') + 1).toLongLong();
+            }
+        }
+        if (m_residentBytes < 0) qWarning() << "Service did not report its resident memory";
+
+        m_phase = Done;
+        emit finished();
+    });
+}
+
+QNetworkRequest LoadGenerator::request(const QString &path) const
+{
+    QUrl url = m_options.target;
+    url.setPath(path);
+
+    QNetworkRequest request(url);
+    if (!m_options.user.isEmpty()) {
+        const QByteArray credentials = (m_options.user + ':' + m_options.password).toUtf8();
+        request.setRawHeader("Authorization", "Basic " + credentials.toBase64());
+    }
+    return request;
+}
+
+QNetworkAccessManager *LoadGenerator::nextManager()
+{
+    QNetworkAccessManager *manager = m_managers[m_nextManager];
+    m_nextManager = (m_nextManager + 1) % m_managers.size();
+    return manager;
+}
+
+double LoadGenerator::percentile(const QList<qint64> &sortedMicros, double p)
+{
+    if (sortedMicros.isEmpty()) return 0;
+    const qsizetype rank = qBound<qsizetype>(0, qsizetype(std::ceil(p * sortedMicros.size())) - 1,
+                                             sortedMicros.size() - 1);
+    return sortedMicros[rank] / 1000.0;
+}
+
+QJsonObject LoadGenerator::report() const
+{
+    QList<qint64> setup = m_setupMicros;
+    QList<qint64> pages = m_pageMicros;
+    std::sort(setup.begin(), setup.end());
+    std::sort(pages.begin(), pages.end());
+
+    const double setupSeconds = m_lastReadyMicros / 1e6;
+
+    QJsonObject report;
+    report["target"] = m_options.target.toString();
+    report["cameras"] = m_options.cameras;
+    report["setup_rate"] = m_options.setupRate;
+    report["ready"] = m_ready;
+    report["failed"] = m_failed + (m_posted - m_answered);
+    report["refused"] = m_refused;
+    report["setup_seconds"] = setupSeconds;
+    report["cameras_per_second"] = setupSeconds > 0 ? m_ready / setupSeconds : 0.0;
+    report["setup_p50_ms"] = percentile(setup, 0.50);
+    report["setup_p99_ms"] = percentile(setup, 0.99);
+    report["page_rate"] = m_options.pageRate;
+    report["pages"] = m_pagesAnswered;
+    report["page_errors"] = m_pageErrors + (m_pagesSent - m_pagesAnswered);
+    report["pages_per_second"] = m_options.pageSeconds > 0 ? double(m_pagesAnswered) / m_options.pageSeconds : 0.0;
+    report["page_p50_ms"] = percentile(pages, 0.50);
+    report["page_p99_ms"] = percentile(pages, 0.99);
+    report["page_bytes"] = m_pageBytes;
+    report["rss_bytes"] = m_residentBytes;
+    return report;
+}
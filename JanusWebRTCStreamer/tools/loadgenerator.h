@@ -0,0 +1,95 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+
+// Drives a running service over its public HTTP API, open loop at fixed
+// rates. First every camera is provisioned with POST /camera/{uuid}, whose
+// response completes once the mountpoint is ready. Then stream pages of
+// the ready cameras are fetched with GET /stream/{uuid} for a fixed time.
+// Finally /metrics is scraped for the service's resident memory.
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QUrl target = QUrl("http://127.0.0.1:8080");
+        int cameras = 1000;
+        double setupRate = 100;     // POST /camera per second
+        double pageRate = 500;      // GET /stream per second
+        int pageSeconds = 10;
+        int connections = 60;       // spread over several network managers
+        int setupTimeoutSec = 120;
+        QString user;               // stream page and /metrics credentials
+        QString password;
+    };
+
+    explicit LoadGenerator(const Options &options, QObject *parent = nullptr);
+
+    void start();
+
+    // Valid after finished()
+    QJsonObject report() const;
+
+signals:
+    void finished();
+
+private slots:
+    void tick();
+
+private:
+    enum Phase {
+        Idle,
+        Setup,
+        Pages,
+        Scrape,
+        Done
+    };
+
+    void postCamera(int index);
+    void getPage();
+    void scrapeMetrics();
+    void finishSetup();
+    void finishPages();
+    QNetworkRequest request(const QString &path) const;
+    QNetworkAccessManager *nextManager();
+
+    static double percentile(const QList<qint64> &sortedMicros, double p);
+
+    Options m_options;
+    QList<QNetworkAccessManager*> m_managers;
+    int m_nextManager;
+    QTimer m_ticker;
+    QElapsedTimer m_phaseTimer;
+    Phase m_phase;
+
+    // Setup phase
+    int m_posted;
+    int m_answered;
+    int m_ready;
+    int m_failed;
+    int m_refused;
+    qint64 m_lastReadyMicros;
+    QList<qint64> m_setupMicros;
+    QStringList m_readyCameras;
+
+    // Page phase
+    qint64 m_pagesSent;
+    qint64 m_pagesAnswered;
+    qint64 m_pageErrors;
+    qint64 m_pageBytes;
+    QList<qint64> m_pageMicros;
+
+    qint64 m_residentBytes;
+};
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,48 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include "mockjanusserver.h"
+
+// In-memory Janus with the streaming plugin, for running the service and
+// the load generator without a real Janus node
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mock_janus");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mock Janus server (HTTP and WebSocket API, streaming plugin)");
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "HTTP API port (serves /janus).", "port", "8088");
+    QCommandLineOption wsPortOption("ws-port", "WebSocket API port, 0 for none.", "port", "8188");
+    QCommandLineOption latencyOption("latency-ms", "Delay before every reply and event.", "ms", "0");
+    QCommandLineOption jitterOption("jitter-ms", "Extra random delay of up to this much.", "ms", "0");
+    QCommandLineOption failureRateOption("failure-rate", "Share of matching requests that fail, 0 to 1.",
+                                         "rate", "0");
+    QCommandLineOption failRequestsOption("fail-requests",
+                                          "Comma-separated requests failures apply to (create, destroy, edit, "
+                                          "list, info, attach, keepalive).", "list", "create");
+    QCommandLineOption asyncOption("async", "Acknowledge streaming requests and answer with an event.");
+    QCommandLineOption sessionTimeoutOption("session-timeout", "Seconds before an idle session times out, 0 never.",
+                                            "seconds", "60");
+    parser.addOptions({ portOption, wsPortOption, latencyOption, jitterOption, failureRateOption,
+                        failRequestsOption, asyncOption, sessionTimeoutOption });
+    parser.process(app);
+
+    MockJanusServer::Options options;
+    options.latencyMs = parser.value(latencyOption).toInt();
+    options.jitterMs = parser.value(jitterOption).toInt();
+    options.failureRate = parser.value(failureRateOption).toDouble();
+    const QStringList failRequests = parser.value(failRequestsOption).split(',', Qt::SkipEmptyParts);
+    options.failRequests = QSet<QString>(failRequests.cbegin(), failRequests.cend());
+    options.asyncPlugin = parser.isSet(asyncOption);
+    options.sessionTimeoutSec = parser.value(sessionTimeoutOption).toInt();
+
+    MockJanusServer server(options);
+    const quint16 port = quint16(parser.value(portOption).toUInt());
+    const quint16 wsPort = quint16(parser.value(wsPortOption).toUInt());
+    if (!server.listen(port, wsPort)) return 1;
+
+    qInfo().noquote() << QString("Mock Janus on http://127.0.0.1:%1/janus, WebSocket port %2").arg(port).arg(wsPort);
+    return app.exec();
+}
@@ -0,0 +1,525 @@
+#include "mockjanusserver.h"
+#include "httpconnection.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QUrlQuery>
+#include <QDebug>
+
+namespace {
+
+// An idle long-poll is answered with a keepalive after this long, as Janus does
+const int PollHoldMs = 30000;
+
+const char *const ApiPath = "/janus";
+const char *const StreamingPlugin = "janus.plugin.streaming";
+
+QJsonObject janusError(const QString &transaction, int code, const QString &reason)
+{
+    QJsonObject error;
+    error["code"] = code;
+    error["reason"] = reason;
+
+    QJsonObject reply;
+    reply["janus"] = "error";
+    reply["transaction"] = transaction;
+    reply["error"] = error;
+    return reply;
+}
+
+QJsonObject pluginError(int code, const QString &reason)
+{
+    QJsonObject data;
+    data["streaming"] = "event";
+    data["error_code"] = code;
+    data["error"] = reason;
+    return data;
+}
+
+QByteArray toJson(const QJsonObject &obj)
+{
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+} // namespace
+
+MockJanusServer::MockJanusServer(const Options &options, QObject *parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_httpServer(new QTcpServer(this))
+    , m_webSocketServer(new QWebSocketServer("mock-janus", QWebSocketServer::NonSecureMode, this))
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+    m_webSocketServer->setSupportedSubprotocols({ "janus-protocol" });
+#endif
+
+    connect(m_httpServer, &QTcpServer::newConnection, this, &MockJanusServer::onHttpConnection);
+    connect(m_webSocketServer, &QWebSocketServer::newConnection, this, &MockJanusServer::onWebSocketConnection);
+
+    m_sweepTimer.setInterval(1000);
+    connect(&m_sweepTimer, &QTimer::timeout, this, &MockJanusServer::sweep);
+}
+
+MockJanusServer::~MockJanusServer()
+{
+    m_webSocketServer->close();
+}
+
+bool MockJanusServer::listen(quint16 httpPort, quint16 wsPort)
+{
+    if (!m_httpServer->listen(QHostAddress::Any, httpPort)) {
+        qWarning() << "Mock Janus cannot listen on HTTP port" << httpPort << m_httpServer->errorString();
+        return false;
+    }
+    if (wsPort != 0 && !m_webSocketServer->listen(QHostAddress::Any, wsPort)) {
+        qWarning() << "Mock Janus cannot listen on WebSocket port" << wsPort << m_webSocketServer->errorString();
+        m_httpServer->close();
+        return false;
+    }
+
+    m_sweepTimer.start();
+    return true;
+}
+
+void MockJanusServer::handleMessage(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+                                    QWebSocket *owner, const Reply &reply)
+{
+    const QString kind = message["janus"].toString();
+    const QString transaction = message["transaction"].toString();
+    auto send = [this, reply](const QJsonObject &obj) { later([reply, obj]() { reply(obj); }); };
+
+    if (transaction.isEmpty()) {
+        send(janusError(transaction, 456, "Missing mandatory element (transaction)"));
+        return;
+    }
+
+    if (sessionId == 0) {
+        if (kind != "create") {
+            send(janusError(transaction, 453, QString("Unhandled request '%1' at this path").arg(kind)));
+            return;
+        }
+        sessionId = newId();
+        Session &session = m_sessions[sessionId];
+        session.socket = owner;
+        session.lastSeen.start();
+
+        QJsonObject data;
+        data["id"] = sessionId;
+        QJsonObject success;
+        success["janus"] = "success";
+        success["transaction"] = transaction;
+        success["data"] = data;
+        send(success);
+        return;
+    }
+
+    auto it = m_sessions.find(sessionId);
+    if (it == m_sessions.end()) {
+        send(janusError(transaction, 458, QString("No such session %1").arg(sessionId)));
+        return;
+    }
+    it->lastSeen.restart();
+
+    QJsonObject success;
+    success["janus"] = "success";
+    success["session_id"] = sessionId;
+    success["transaction"] = transaction;
+
+    if (kind == "keepalive") {
+        if (injectFailure("keepalive")) {
+            send(janusError(transaction, 490, "Injected failure"));
+            return;
+        }
+        QJsonObject ack;
+        ack["janus"] = "ack";
+        ack["session_id"] = sessionId;
+        ack["transaction"] = transaction;
+        send(ack);
+    } else if (kind == "attach") {
+        if (message["plugin"].toString() != StreamingPlugin) {
+            send(janusError(transaction, 460, QString("No such plugin '%1'").arg(message["plugin"].toString())));
+            return;
+        }
+        if (injectFailure("attach")) {
+            send(janusError(transaction, 490, "Injected failure"));
+            return;
+        }
+        const qint64 id = newId();
+        it->handles.insert(id);
+        QJsonObject data;
+        data["id"] = id;
+        success["data"] = data;
+        send(success);
+    } else if (kind == "destroy") {
+        destroySession(sessionId);
+        send(success);
+    } else if (kind == "detach" && handleId != 0) {
+        if (!it->handles.remove(handleId)) {
+            send(janusError(transaction, 459, QString("No such handle %1 in session %2").arg(handleId).arg(sessionId)));
+            return;
+        }
+        send(success);
+    } else if (kind == "message" && handleId != 0) {
+        if (!it->handles.contains(handleId)) {
+            send(janusError(transaction, 459, QString("No such handle %1 in session %2").arg(handleId).arg(sessionId)));
+            return;
+        }
+
+        QJsonObject plugindata;
+        plugindata["plugin"] = StreamingPlugin;
+        plugindata["data"] = streamingRequest(message["body"].toObject());
+
+        QJsonObject result = success;
+        result["sender"] = handleId;
+        result["plugindata"] = plugindata;
+
+        if (!m_options.asyncPlugin) {
+            send(result);
+            return;
+        }
+
+        // Acknowledge now, answer with an event on the session
+        QJsonObject ack;
+        ack["janus"] = "ack";
+        ack["session_id"] = sessionId;
+        ack["transaction"] = transaction;
+        send(ack);
+
+        result["janus"] = "event";
+        later([this, sessionId, result]() { pushEvent(sessionId, result); });
+    } else {
+        send(janusError(transaction, 453, QString("Unknown request '%1'").arg(kind)));
+    }
+}
+
+QJsonObject MockJanusServer::streamingRequest(const QJsonObject &body)
+{
+    const QString request = body["request"].toString();
+    const int id = body["id"].toInt();
+
+    if (injectFailure(request)) return pluginError(499, "Injected failure");
+
+    QJsonObject data;
+    if (request == "create") {
+        int mountpointId = id;
+        if (mountpointId == 0) {
+            mountpointId = m_mountpoints.isEmpty() ? 1 : m_mountpoints.lastKey() + 1;
+        } else if (m_mountpoints.contains(mountpointId)) {
+            return pluginError(456, QString("A stream with the provided ID %1 already exists").arg(mountpointId));
+        }
+
+        Mountpoint &mountpoint = m_mountpoints[mountpointId];
+        mountpoint.name = body["name"].toString();
+        mountpoint.description = body["description"].toString();
+        mountpoint.metadata = body["metadata"].toString();
+        mountpoint.url = body["url"].toString();
+
+        QJsonObject stream;
+        stream["id"] = mountpointId;
+        stream["type"] = "live";
+        stream["description"] = mountpoint.description;
+        stream["is_private"] = false;
+        data["streaming"] = "created";
+        data["created"] = mountpoint.name;
+        data["permanent"] = false;
+        data["stream"] = stream;
+    } else if (request == "destroy") {
+        if (!m_mountpoints.remove(id)) return pluginError(455, QString("No such mountpoint/stream %1").arg(id));
+        data["streaming"] = "destroyed";
+        data["id"] = id;
+    } else if (request == "edit") {
+        auto it = m_mountpoints.find(id);
+        if (it == m_mountpoints.end()) return pluginError(455, QString("No such mountpoint/stream %1").arg(id));
+        if (body.contains("new_description")) it->description = body["new_description"].toString();
+        if (body.contains("new_metadata")) it->metadata = body["new_metadata"].toString();
+        data["streaming"] = "edited";
+        data["id"] = id;
+    } else if (request == "list") {
+        QJsonArray list;
+        for (auto it = m_mountpoints.cbegin(); it != m_mountpoints.cend(); ++it) {
+            QJsonObject entry;
+            entry["id"] = it.key();
+            entry["type"] = "live";
+            entry["description"] = it->description;
+            entry["metadata"] = it->metadata;
+            entry["enabled"] = true;
+            list.append(entry);
+        }
+        data["streaming"] = "list";
+        data["list"] = list;
+    } else if (request == "info") {
+        auto it = m_mountpoints.constFind(id);
+        if (it == m_mountpoints.cend()) return pluginError(455, QString("No such mountpoint/stream %1").arg(id));
+        QJsonObject info;
+        info["id"] = id;
+        info["name"] = it->name;
+        info["type"] = "live";
+        info["description"] = it->description;
+        info["metadata"] = it->metadata;
+        info["url"] = it->url;
+        data["streaming"] = "info";
+        data["info"] = info;
+    } else {
+        return pluginError(453, QString("Unknown request '%1'").arg(request));
+    }
+    return data;
+}
+
+void MockJanusServer::pushEvent(qint64 sessionId, const QJsonObject &event)
+{
+    auto it = m_sessions.find(sessionId);
+    if (it == m_sessions.end()) return;
+
+    if (it->socket) {
+        it->socket->sendTextMessage(QString::fromUtf8(toJson(event)));
+        return;
+    }
+    it->events.append(event);
+    flushPolls(*it);
+}
+
+void MockJanusServer::flushPolls(Session &session)
+{
+    while (!session.events.isEmpty() && !session.polls.isEmpty()) {
+        const Poll poll = session.polls.takeFirst();
+        if (!poll.socket) continue;
+
+        // maxev > 1 is answered with an array
+        if (poll.maxEvents > 1) {
+            QJsonArray events;
+            while (!session.events.isEmpty() && events.size() < poll.maxEvents) {
+                events.append(session.events.takeFirst());
+            }
+            respondHttp(poll.socket, 200, "OK", QJsonDocument(events).toJson(QJsonDocument::Compact));
+        } else {
+            respondHttp(poll.socket, 200, "OK", toJson(session.events.takeFirst()));
+        }
+    }
+}
+
+void MockJanusServer::destroySession(qint64 sessionId)
+{
+    Session session = m_sessions.take(sessionId);
+
+    // Waiting polls get an empty keepalive so their connections free up
+    QJsonObject keepAlive;
+    keepAlive["janus"] = "keepalive";
+    for (const Poll &poll : std::as_const(session.polls)) {
+        if (poll.socket) respondHttp(poll.socket, 200, "OK", toJson(keepAlive));
+    }
+}
+
+void MockJanusServer::sweep()
+{
+    QList<qint64> expired;
+    for (auto it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+        Session &session = it.value();
+
+        for (auto poll = session.polls.begin(); poll != session.polls.end(); ) {
+            if (!poll->socket) {
+                poll = session.polls.erase(poll);
+            } else if (poll->waiting.elapsed() >= PollHoldMs) {
+                QJsonObject keepAlive;
+                keepAlive["janus"] = "keepalive";
+                QPointer<QTcpSocket> socket = poll->socket;
+                poll = session.polls.erase(poll);
+                respondHttp(socket, 200, "OK", toJson(keepAlive));
+            } else {
+                ++poll;
+            }
+        }
+
+        if (m_options.sessionTimeoutSec > 0 && session.lastSeen.elapsed() >= m_options.sessionTimeoutSec * 1000LL) {
+            expired.append(it.key());
+        }
+    }
+
+    for (qint64 sessionId : std::as_const(expired)) {
+        QJsonObject timeout;
+        timeout["janus"] = "timeout";
+        timeout["session_id"] = sessionId;
+        pushEvent(sessionId, timeout);
+        destroySession(sessionId);
+    }
+}
+
+void MockJanusServer::onHttpConnection()
+{
+    while (QTcpSocket *socket = m_httpServer->nextPendingConnection()) {
+        m_httpClients.insert(socket, HttpClient());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readHttp(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_httpClients.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MockJanusServer::readHttp(QTcpSocket *socket)
+{
+    auto it = m_httpClients.find(socket);
+    if (it == m_httpClients.end()) return;
+
+    it->parser.append(socket->readAll());
+    while (!it->busy) {
+        const HttpRequestParser::Status status = it->parser.parse();
+        if (status == HttpRequestParser::NeedMoreData) return;
+        if (status != HttpRequestParser::RequestReady) {
+            respondHttp(socket, 400, "Bad Request", QByteArray());
+            socket->disconnectFromHost();
+            return;
+        }
+
+        it->busy = true;
+        handleHttpRequest(socket, it->parser.takeRequest());
+
+        // The handler may have answered, or dropped the connection
+        it = m_httpClients.find(socket);
+        if (it == m_httpClients.end()) return;
+    }
+}
+
+void MockJanusServer::handleHttpRequest(QTcpSocket *socket, const HttpRequest &request)
+{
+    const qsizetype query = request.path.indexOf('?');
+    const QByteArray path = query == -1 ? request.path : request.path.left(query);
+    if (!path.startsWith(ApiPath)) {
+        respondHttp(socket, 404, "Not Found", QByteArray());
+        return;
+    }
+
+    const QList<QByteArray> segments = path.mid(qstrlen(ApiPath)).split('/');
+    qint64 ids[2] = { 0, 0 };
+    int idCount = 0;
+    for (const QByteArray &segment : segments) {
+        if (segment.isEmpty()) continue;
+        if (idCount == 2) {
+            respondHttp(socket, 404, "Not Found", QByteArray());
+            return;
+        }
+        ids[idCount++] = segment.toLongLong();
+    }
+
+    if (request.method == "GET") {
+        auto it = m_sessions.find(ids[0]);
+        if (idCount != 1 || it == m_sessions.end()) {
+            respondHttp(socket, 200, "OK", toJson(janusError(QString(), 458, QString("No such session %1").arg(ids[0]))));
+            return;
+        }
+        it->lastSeen.restart();
+
+        Poll poll;
+        poll.socket = socket;
+        poll.maxEvents = 1;
+        if (query != -1) {
+            const QUrlQuery items(QString::fromUtf8(request.path.mid(query + 1)));
+            poll.maxEvents = qMax(1, items.queryItemValue("maxev").toInt());
+        }
+        poll.waiting.start();
+        it->polls.append(poll);
+        flushPolls(*it);
+        return;
+    }
+
+    if (request.method != "POST") {
+        respondHttp(socket, 405, "Method Not Allowed", QByteArray());
+        return;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(request.body, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        respondHttp(socket, 200, "OK", toJson(janusError(QString(), 454, "JSON error: " + parseError.errorString())));
+        return;
+    }
+
+    QPointer<QTcpSocket> client = socket;
+    handleMessage(doc.object(), ids[0], ids[1], nullptr, [this, client](const QJsonObject &reply) {
+        if (client) respondHttp(client, 200, "OK", toJson(reply));
+    });
+}
+
+void MockJanusServer::respondHttp(QTcpSocket *socket, int statusCode, const QByteArray &statusText,
+                                  const QByteArray &body)
+{
+    auto it = m_httpClients.find(socket);
+    if (it == m_httpClients.end()) return;
+
+    socket->write(HttpConnection::serializeResponse(statusCode, statusText, "Content-Type: application/json\r\n",
+                                                    "Connection: keep-alive\r\n", body));
+    it->busy = false;
+
+    // Pipelined requests that arrived while this one was pending
+    if (it->parser.hasBufferedData()) {
+        QMetaObject::invokeMethod(this, [this, client = QPointer<QTcpSocket>(socket)]() {
+            if (client) readHttp(client);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void MockJanusServer::onWebSocketConnection()
+{
+    while (QWebSocket *socket = m_webSocketServer->nextPendingConnection()) {
+        // Clients are dropped when the mock goes away, like a Janus restart
+        socket->setParent(this);
+        QPointer<QWebSocket> client = socket;
+        connect(socket, &QWebSocket::textMessageReceived, this, [this, client](const QString &text) {
+            if (!client) return;
+
+            QJsonParseError parseError;
+            const QJsonDocument doc = QJsonDocument::fromJson(text.toUtf8(), &parseError);
+            if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+                client->sendTextMessage(QString::fromUtf8(toJson(janusError(QString(), 454, "JSON error"))));
+                return;
+            }
+
+            const QJsonObject message = doc.object();
+            const qint64 sessionId = message["session_id"].toVariant().toLongLong();
+            const qint64 handleId = message["handle_id"].toVariant().toLongLong();
+            handleMessage(message, sessionId, handleId, client, [client](const QJsonObject &reply) {
+                if (client) client->sendTextMessage(QString::fromUtf8(toJson(reply)));
+            });
+        });
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]() {
+            // Like Janus, sessions created over a socket end with it
+            QList<qint64> owned;
+            for (auto it = m_sessions.cbegin(); it != m_sessions.cend(); ++it) {
+                if (it->socket == socket) owned.append(it.key());
+            }
+            for (qint64 sessionId : std::as_const(owned)) destroySession(sessionId);
+            socket->deleteLater();
+        });
+    }
+}
+
+bool MockJanusServer::injectFailure(const QString &request) const
+{
+    if (m_options.failureRate <= 0 || !m_options.failRequests.contains(request)) return false;
+    return QRandomGenerator::global()->generateDouble() < m_options.failureRate;
+}
+
+int MockJanusServer::replyDelay() const
+{
+    if (m_options.jitterMs <= 0) return m_options.latencyMs;
+    return m_options.latencyMs + QRandomGenerator::global()->bounded(m_options.jitterMs + 1);
+}
+
+void MockJanusServer::later(const std::function<void()> &callback)
+{
+    const int delay = replyDelay();
+    if (delay <= 0) {
+        callback();
+        return;
+    }
+    QTimer::singleShot(delay, this, callback);
+}
+
+qint64 MockJanusServer::newId() const
+{
+    // Janus IDs are random and fit in a JSON number (53 bits)
+    qint64 id;
+    do {
+        id = qint64(QRandomGenerator::global()->generate64() & ((Q_UINT64_C(1) << 53) - 1));
+    } while (id == 0 || m_sessions.contains(id));
+    return id;
+}
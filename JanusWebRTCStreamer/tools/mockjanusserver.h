@@ -0,0 +1,108 @@
+#ifndef MOCKJANUSSERVER_H
+#define MOCKJANUSSERVER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QPointer>
+#include <QSet>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QWebSocket>
+#include <QWebSocketServer>
+#include <functional>
+#include "httprequestparser.h"
+
+// Stand-in for a Janus node with the streaming plugin, for load tests.
+// Speaks the Janus HTTP API (POST per message, GET long-poll for events)
+// and the WebSocket API, and implements session create/destroy, attach,
+// keepalive and the streaming create, destroy, edit, list and info
+// requests. Mountpoints only exist in memory; no media is involved.
+class MockJanusServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        int latencyMs = 0;          // added before every reply and event
+        int jitterMs = 0;           // plus up to this much at random
+        double failureRate = 0;     // share of failRequests answered with an error
+        QSet<QString> failRequests = { "create" };  // streaming requests, or "attach"/"keepalive"
+        bool asyncPlugin = false;   // ack streaming requests and answer with an event
+        int sessionTimeoutSec = 60; // sessions without traffic time out, 0 never
+    };
+
+    explicit MockJanusServer(const Options &options, QObject *parent = nullptr);
+    ~MockJanusServer();
+
+    // wsPort 0 leaves the WebSocket API off
+    bool listen(quint16 httpPort, quint16 wsPort);
+
+    int mountpointCount() const { return m_mountpoints.size(); }
+    int sessionCount() const { return m_sessions.size(); }
+
+private slots:
+    void onHttpConnection();
+    void onWebSocketConnection();
+    void sweep();
+
+private:
+    using Reply = std::function<void(const QJsonObject &reply)>;
+
+    struct Mountpoint {
+        QString name;
+        QString description;
+        QString metadata;
+        QString url;
+    };
+
+    struct Poll {
+        QPointer<QTcpSocket> socket;
+        int maxEvents = 1;
+        QElapsedTimer waiting;
+    };
+
+    struct Session {
+        QSet<qint64> handles;
+        QList<QJsonObject> events;      // queued for the next HTTP poll
+        QList<Poll> polls;
+        QPointer<QWebSocket> socket;    // sessions created over WebSocket get events pushed
+        QElapsedTimer lastSeen;
+    };
+
+    struct HttpClient {
+        HttpRequestParser parser;
+        bool busy = false;              // answering a request; later ones wait
+    };
+
+    void handleMessage(const QJsonObject &message, qint64 sessionId, qint64 handleId,
+                       QWebSocket *owner, const Reply &reply);
+    QJsonObject streamingRequest(const QJsonObject &body);
+    void pushEvent(qint64 sessionId, const QJsonObject &event);
+    void flushPolls(Session &session);
+    void destroySession(qint64 sessionId);
+
+    void readHttp(QTcpSocket *socket);
+    void handleHttpRequest(QTcpSocket *socket, const HttpRequest &request);
+    void respondHttp(QTcpSocket *socket, int statusCode, const QByteArray &statusText, const QByteArray &body);
+
+    bool injectFailure(const QString &request) const;
+    int replyDelay() const;
+    void later(const std::function<void()> &callback);
+    qint64 newId() const;
+
+    Options m_options;
+    QTcpServer *m_httpServer;
+    QWebSocketServer *m_webSocketServer;
+    QTimer m_sweepTimer;
+
+    QHash<qint64, Session> m_sessions;
+    QHash<QTcpSocket*, HttpClient> m_httpClients;
+    QMap<int, Mountpoint> m_mountpoints;
+};
+
+#endif // MOCKJANUSSERVER_H
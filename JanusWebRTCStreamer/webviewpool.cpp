@@ -0,0 +1,104 @@
+#include "webviewpool.h"
+#include <QDebug>
+#include <QWebEngineSettings>
+#include <QWebEnginePage>
+
+WebViewPool::WebViewPool(int maxViews, QObject *parent)
+    : PreviewProvider(parent)
+    , m_maxViews(qMax(1, maxViews))
+    , m_activeCount(0)
+{
+}
+
+WebViewPool::~WebViewPool()
+{
+    qDeleteAll(m_idleViews);
+    m_idleViews.clear();
+    qDeleteAll(m_previews);
+    m_previews.clear();
+}
+
+bool WebViewPool::showPreview(QObject *connector, const QString &html)
+{
+    QWebEngineView *view = m_previews.value(connector);
+    if (!view) {
+        view = acquire(connector);
+        if (!view) return false;
+        m_previews.insert(connector, view);
+    }
+
+    view->setHtml(html);
+    view->show();
+    return true;
+}
+
+void WebViewPool::hidePreview(QObject *connector)
+{
+    QWebEngineView *view = m_previews.take(connector);
+    if (view) release(view, connector);
+}
+
+QWebEngineView *WebViewPool::acquire(QObject *connector)
+{
+    QWebEngineView *view = nullptr;
+
+    if (!m_idleViews.isEmpty()) {
+        view = m_idleViews.takeLast();
+    } else if (m_activeCount < m_maxViews) {
+        view = createView();
+    } else {
+        qWarning() << "Preview pool exhausted, max views:" << m_maxViews;
+        return nullptr;
+    }
+
+    view->page()->webChannel()->registerObject("qtConnector", connector);
+    m_activeCount++;
+    return view;
+}
+
+void WebViewPool::release(QWebEngineView *view, QObject *connector)
+{
+    if (!view) return;
+
+    view->hide();
+    view->page()->webChannel()->deregisterObject(connector);
+    // Drop the page so the WebRTC session and renderer state go away
+    view->setHtml(QString());
+    m_activeCount--;
+
+    if (m_idleViews.size() + m_activeCount < m_maxViews) {
+        m_idleViews.append(view);
+    } else {
+        view->deleteLater();
+    }
+}
+
+void WebViewPool::setMaxViews(int maxViews)
+{
+    m_maxViews = qMax(1, maxViews);
+
+    // Trim idle views above the new limit
+    while (!m_idleViews.isEmpty() && m_idleViews.size() + m_activeCount > m_maxViews) {
+        m_idleViews.takeLast()->deleteLater();
+    }
+}
+
+QWebEngineView *WebViewPool::createView()
+{
+    QWebEngineView *view = new QWebEngineView();
+    view->resize(1280, 720);
+    view->setWindowTitle("Janus WebRTC Stream");
+
+    QWebEngineSettings *settings = view->page()->settings();
+    settings->setAttribute(QWebEngineSettings::JavascriptEnabled, true);
+    settings->setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls, true);
+    settings->setAttribute(QWebEngineSettings::AllowRunningInsecureContent, true);
+
+    view->setContextMenuPolicy(Qt::DefaultContextMenu);
+
+    // The channel is parented to the view so it goes away with it
+    view->page()->setWebChannel(new QWebChannel(view));
+
+    qDebug() << "Preview view created, active:" << m_activeCount + 1 << "max:" << m_maxViews;
+    return view;
+}
@@ -0,0 +1,43 @@
+#ifndef WEBVIEWPOOL_H
+#define WEBVIEWPOOL_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QWebEngineView>
+#include <QWebChannel>
+#include "previewprovider.h"
+
+// Bounded pool of local preview views. Views are only created when a preview
+// is actually requested and are reused after release, so registering a camera
+// no longer costs a Chromium-backed view.
+class WebViewPool : public PreviewProvider
+{
+    Q_OBJECT
+
+public:
+    explicit WebViewPool(int maxViews = 4, QObject *parent = nullptr);
+    ~WebViewPool();
+
+    bool showPreview(QObject *connector, const QString &html) override;
+    void hidePreview(QObject *connector) override;
+
+    // Returns nullptr when all views are in use
+    QWebEngineView *acquire(QObject *connector);
+    void release(QWebEngineView *view, QObject *connector);
+
+    void setMaxViews(int maxViews);
+    int maxViews() const { return m_maxViews; }
+    int activeCount() const { return m_activeCount; }
+    int idleCount() const { return m_idleViews.size(); }
+
+private:
+    QWebEngineView *createView();
+
+    QList<QWebEngineView*> m_idleViews;
+    QHash<QObject*, QWebEngineView*> m_previews;
+    int m_maxViews;
+    int m_activeCount;
+};
+
+#endif // WEBVIEWPOOL_H